@@ -7,6 +7,14 @@
 #include <queue>
 #include <deque>
 #include <list>
+#include <algorithm>
+
+#include "WayMatch.h"
+#include "Replacement.h"
+#include "Prefetch.h"
+#include "Events.h"
+#include "Stats.h"
+#include "Trace.h"
 
 #define ADDRESSBITS 32
 
@@ -19,80 +27,27 @@ struct {
    uint32_t L2_ASSOC;
    uint32_t PREF_N;
    uint32_t PREF_M;
+   uint32_t L1_POLICY;      // replacement_t, REPL_LRU unless --l1-policy is given
+   uint32_t L2_POLICY;      // replacement_t, REPL_LRU unless --l2-policy is given
+   uint32_t PREFETCHER;     // prefetcher_t, PREF_STREAM unless --prefetcher is given
 } cache_params_t;
 
 class cache;
+class coherence_controller;
+class timing_model;
 
-class cache_block{
-   public:
-   bool valid;          // 0 == invalid, 1 == valid
-   uint32_t data;       // Tag + Index + Block Offset       
-   bool dirty;          // 0 == clean 1 == dirty
-   uint32_t LRUCounter;
-   int tag;     // Tag
-
-   // Default constructor
-    cache_block(uint32_t blocksize, uint32_t LRUmax){
-        this->valid = false;       // Blocks initialize as invalid      
-        this->data = 0;
-        this->tag = 0x0;   
-        this->dirty = 0;
-        this->LRUCounter = LRUmax;     // Initialize blocks with LRU counter = 3 (next to replace)
-    }
-
-};
-
-class cache_set{
-    public:
-    std::vector<cache_block> set;
-    uint32_t LRU_max;
-
-    // Constructor that associates blocks in a set
-    // Constructor
-    cache_set(uint32_t assoc, uint32_t blocksize){
-        this->LRU_max = assoc - 1;
-        for (int i = 0; i < (int)assoc; i++){
-            set.emplace_back(blocksize, LRU_max);
-    }
-}
-
-    // Getter
-    std::vector<cache_block>* getCacheSet();
-    uint32_t getLRU_max();
-};
-
-class streamBlock {
-public:
-    uint32_t address;   // Address of the block
-
-    // Default Constructor
-    streamBlock() : address(0) {};
-
-    // Constructor 
-    streamBlock(uint32_t addr) : address(addr) {};
-};
-
+// A stream buffer is a ring of consecutive block numbers: head, head + 1, ...
+// head + count - 1. Only head and count are stored, so a hit is a range check.
 class streamBuffer {
 public:
-    int lruStreamBuffer;
-    bool valid;     // 0 = Empty, 1 = Full
-    std::deque<streamBlock> streamQueue;
-    int size;
+    uint32_t head;      // First (oldest) block number in the buffer
+    uint32_t count;     // Blocks held; 0 == empty
 
     // Default Constructor
-    streamBuffer() {
-        this->valid = false;
-        this->lruStreamBuffer = 0;
-        this->size = 0;
-    }
+    streamBuffer() : head(0), count(0) {};
 
-    // Constructor
-    streamBuffer(int lruValue, int size) {
-        this->valid = false;
-        //this->lruStreamBuffer = lruValue;
-        this->streamQueue.resize(size);
-        this->size = size;
-    }
+    bool valid() const { return this->count != 0; }
+    bool holds(uint32_t block) const { return block - this->head < this->count; }
 };
 
 class prefetchUnit {
@@ -100,7 +55,7 @@ public:
     int N;  // Number of stream buffers
     int M;  // Blocks in each stream buffer
     uint32_t tempAddr;  // New member variable
-    std::vector<streamBuffer> streamBuffers;  // vector of stream buffers
+    std::vector<streamBuffer> streamBuffers;  // Kept in MRU order: [0] most recently used, [N - 1] least
 
     // Default Constructor
     prefetchUnit() : N(0), M(0), tempAddr(0) {
@@ -111,19 +66,37 @@ public:
     // Constructor
     prefetchUnit(uint32_t numBuffers, uint32_t blocksPerBuffer) 
         : N(numBuffers), M(blocksPerBuffer), tempAddr(0) {
-        // Initialize Stream Buffers
-        for (int i = 0; i < N; ++i) {
-            streamBuffers.emplace_back(i, M);  // Using streamBuffer constructor that takes capacity
-            streamBuffers[i].lruStreamBuffer = N - i - 1;
-        }
+        // All stream buffers start empty
+        streamBuffers.resize(N);
     }
 
+    // Move stream buffer i to the MRU position
+    void touch(uint32_t i) {
+        std::rotate(streamBuffers.begin(), streamBuffers.begin() + i, streamBuffers.begin() + i + 1);
+    }
 };
 
 class cache{
     public:
+    // Set storage, flat and set-major: way w of set s lives in slot s * assoc + w.
+    // Tags are one array; valid and dirty bits are packed bitmaps of
+    // bitmap_words 64-bit words per set. Replacement state lives in the policy.
+    std::vector<uint32_t> tags;
+    std::vector<uint64_t> valid_bits;
+    std::vector<uint64_t> dirty_bits;
+    uint32_t num_sets;
+    uint32_t bitmap_words;
+
+    replacement_t replacement;
+    replacement_policy* policy;
+    way_match_fn match_ways;
+
+    // request() runs request_impl<> specialized for this cache's geometry when one
+    // was compiled in, else the runtime_geometry version (see Geometry.h)
+    void (cache::*request_fn)(uint32_t addr, char rw);
+    bool unrolled_lookup;         // request_fn compares tags in an unrolled loop, not with match_ways
+
     // Cache Configuration
-    std::vector<cache_set> cache_array;
     uint32_t cache_size;
     uint32_t assoc;
     uint32_t blocksize;
@@ -131,25 +104,59 @@ class cache{
     uint32_t index_bit_size;
     uint32_t blockoffset_size;
 
-    // Cache Measurements
-    uint32_t reads;
-    uint32_t writes;
-    uint32_t read_miss_count;
-    uint32_t write_miss_count;
-    uint32_t memory_traffic;
-    uint32_t prefetches;
-    uint32_t reads_prefetch;
-    uint32_t read_miss_prefetch;
-    uint32_t writeback;     // May need to go somewhere else
+    // Cache Measurements, 64-bit so long traces do not wrap; registered in stats (see Stats.h)
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_miss_count;
+    uint64_t write_miss_count;
+    uint64_t memory_traffic;
+    uint64_t prefetches;
+    uint64_t reads_prefetch;
+    uint64_t read_miss_prefetch;
+    uint64_t writeback;     // May need to go somewhere else
+    uint64_t prefetches_useful;     // Prefetched blocks (or stream buffer blocks) later demanded
+    uint64_t prefetches_late;       // Useful, but demanded before they arrived
+    uint64_t prefetches_polluting;  // Prefetch fills that evicted a block demanded again
+    stats_registry stats;
 
     cache *level_below;
     std::string cache_name;
+    uint32_t level;             // 1 == L1, 2 == L2; tags traced events
+
+    // Shared levels of a multi-core run (see Multicore.h): the core that filled each
+    // slot, the core whose request is being served, and per core how many of its
+    // blocks were evicted by another core's fill. owner stays empty otherwise.
+    std::vector<uint16_t> owner;
+    uint32_t requester;
+    std::vector<uint64_t> interference_evictions;
+    uint64_t interference_total;
+
+    // Private L1s of a coherent multi-core run (see Coherence.h). A valid block is
+    // M if dirty, else E if its exclusive bit is set, else S. coherence is NULL otherwise.
+    coherence_controller* coherence;
+    uint32_t core_id;
+    std::vector<uint64_t> exclusive_bits;       // Same layout as valid_bits
+
+    timing_model* timing;       // Told about every prefetch when --timing is on (see Timing.h), else NULL
+
+    // While request_batch() runs, the requests for level_below queue here in issue order
+    std::vector<trace_request_t> batch_below;
+    bool batching;
 
     // Prefetch Config
     uint32_t prefN;
     uint32_t prefM;
     prefetchUnit* prefetch_Unit;
     bool prefetch_enabled;
+
+    // Engines other than the stream buffers prefetch into the cache itself. Those
+    // blocks are flagged until first demanded, with the request count they arrive at.
+    prefetcher_t prefetcher_type;
+    prefetcher* prefetch_engine;                // NULL when the stream buffers are used
+    std::vector<uint64_t> prefetched_bits;      // Same layout as valid_bits
+    std::vector<uint64_t> prefetch_ready;       // Per slot
+    std::vector<uint32_t> pollution_filter;     // block + 1 of blocks evicted by prefetch fills, 0 == empty
+    std::vector<uint32_t> prefetch_candidates;  // Scratch for prefetch_engine->train()
     // Default Constructor
     cache(){
         this->blocksize = 0;
@@ -159,27 +166,55 @@ class cache{
         this->prefM = 0;
         this->level_below = nullptr;
         this->cache_name = "";
+        this->level = 0;
+        this->requester = 0;
+        this->interference_total = 0;
+        this->coherence = nullptr;
+        this->core_id = 0;
+        this->timing = nullptr;
+        this->batching = false;
+        this->prefetch_Unit = nullptr;
+        this->prefetch_enabled = false;
+        this->prefetcher_type = PREF_STREAM;
+        this->prefetch_engine = nullptr;
+        this->replacement = REPL_LRU;
+        this->policy = nullptr;
+        this->match_ways = way_match_scalar;
+        this->request_fn = nullptr;
+        this->unrolled_lookup = false;
     }
 
     // Constructor
     cache(uint32_t blocksize, uint32_t cache_size, uint32_t assoc, uint32_t pref_N, uint32_t pref_M, 
-    cache* level_below, std::string cache_name){
+    cache* level_below, std::string cache_name, replacement_t replacement = REPL_LRU, prefetcher_t prefetcher_type = PREF_STREAM){
     this->blocksize = blocksize;
     this->assoc = assoc;
     this->cache_size = cache_size;
-    int num_sets = cache_size / (assoc * blocksize);    // Calculate number of sets
-    this->cache_array.reserve(num_sets);
+    this->num_sets = cache_size / (assoc * blocksize);  // Calculate number of sets
     this->level_below = level_below;
 
-    for (int i = 0; i < num_sets; i++){                 // for loop for creating sets
-        this->cache_array.emplace_back(assoc, blocksize);
-    } 
+    // All blocks start invalid and clean
+    this->bitmap_words = (assoc + 63) / 64;
+    this->tags.assign((size_t)num_sets * assoc, 0);
+    this->replacement = replacement;
+    this->policy = make_replacement_policy(replacement, num_sets, assoc);
+    this->valid_bits.assign((size_t)num_sets * bitmap_words, 0);
+    this->dirty_bits.assign((size_t)num_sets * bitmap_words, 0);
+    this->match_ways = select_way_match();
 
     this->blockoffset_size = std::log2(blocksize); // Calculate block offset bits
-    this->index_bit_size = std::log2(cache_array.size());
+    this->index_bit_size = std::log2(num_sets);
 
     this->tag_bit_size = ADDRESSBITS - index_bit_size - blockoffset_size;
     this->cache_name = cache_name;
+    this->level = 0;
+    this->requester = 0;
+    this->interference_total = 0;
+    this->coherence = nullptr;
+    this->core_id = 0;
+    this->timing = nullptr;
+    this->batching = false;
+    this->select_engine();
 
     // Initialize stat counters
     this->reads = 0;
@@ -191,39 +226,106 @@ class cache{
     this->prefetches = 0;
     this->reads_prefetch = 0;
     this->read_miss_prefetch = 0;
+    this->prefetches_useful = 0;
+    this->prefetches_late = 0;
+    this->prefetches_polluting = 0;
 
     // Prefetch Config
+    this->prefetcher_type = prefetcher_type;
+    this->prefetch_engine = nullptr;
     if(pref_N != 0 && pref_M != 0){
         this->prefN = pref_N;
         this->prefM = pref_M;
         this->prefetch_Unit = new prefetchUnit(prefN, prefM);
         this->prefetch_enabled = true;
+        this->prefetch_engine = make_prefetcher(prefetcher_type, prefN, prefM);
+        if (this->prefetch_engine != nullptr) {
+            this->prefetched_bits.assign((size_t)num_sets * bitmap_words, 0);
+            this->prefetch_ready.assign((size_t)num_sets * assoc, 0);
+            this->pollution_filter.assign(POLLUTION_FILTER_SIZE, 0);
+        }
     } else {
         this->prefN = 10;
         this->prefM = 10;
         this->prefetch_Unit = new prefetchUnit(10, 10);
         this->prefetch_enabled = false;
     }
+    this->register_stats();
 }
 
-    void request(uint32_t addr, char rw);
+    // Destructor
+    ~cache(){
+        delete this->prefetch_Unit;
+        delete this->prefetch_engine;
+        delete this->policy;
+    }
+
+    void request(uint32_t addr, char rw){ (this->*request_fn)(addr, rw); }
+    // Same end state as request() on each in turn: this level runs the whole batch, then
+    // the level below runs what it sent down. Only for levels nothing else drives.
+    void request_batch(const trace_request_t *requests, size_t count);
+    void send_below(uint32_t addr, char rw){
+        if (this->batching) { this->queue_below(addr, rw); }
+        else { this->level_below->request(addr, rw); }
+    }
+    void queue_below(uint32_t addr, char rw);       // Out of line, keeps request_impl<> small
+    template<class Geometry> void request_impl(uint32_t addr, char rw);
+    void select_engine();
+    const char* tag_compare_name() const;       // "unrolled", or the way-match kernel's name
     //parsed_addr parse_address(uint32_t addr, char rw);    // Break instruction into tag, index, and block offset
     void print_cache_size();
     uint32_t parse_tag(uint32_t addr);
     uint32_t parse_index(uint32_t addr);
     uint32_t parse_offset(uint32_t addr);
-    void update_lru(uint32_t current_LRUcounter, uint32_t addr, std::vector<cache_block> *setptr, int set_index);
-    void install_block(int index, uint32_t addr, std::vector<cache_block> *setptr, char rw);
+    void install_block(uint32_t set, uint32_t way, uint32_t addr, char rw);
     //void write_back_to_lower_level(uint32_t addr);
-    void writeback_logic(uint32_t addr, uint32_t index, std::vector<cache_block> *setptr);
+    void writeback_logic(uint32_t set, uint32_t way);
+    bool lookup(uint32_t set, uint32_t tag, uint32_t& way);
+    bool find_block(uint32_t addr, uint32_t& set, uint32_t& way);     // Like lookup, but no victim choice
+    void invalidate_block(uint32_t set, uint32_t way, bool write_back);
+
+    // Slot and bitmap helpers
+    uint32_t slot(uint32_t set, uint32_t way) const { return set * assoc + way; }
+    bool is_valid(uint32_t set, uint32_t way) const { return (valid_bits[set * bitmap_words + way / 64] >> (way % 64)) & 1; }
+    bool is_dirty(uint32_t set, uint32_t way) const { return (dirty_bits[set * bitmap_words + way / 64] >> (way % 64)) & 1; }
+    void set_valid(uint32_t set, uint32_t way) { valid_bits[set * bitmap_words + way / 64] |= (uint64_t)1 << (way % 64); }
+    void set_dirty(uint32_t set, uint32_t way, bool dirty) {
+        uint64_t bit = (uint64_t)1 << (way % 64);
+        if (dirty) { dirty_bits[set * bitmap_words + way / 64] |= bit; }
+        else { dirty_bits[set * bitmap_words + way / 64] &= ~bit; }
+    }
+    // Rebuild a block's address from its tag and set (block offset is zero)
+    uint32_t block_address(uint32_t set, uint32_t way) const {
+        return (tags[slot(set, way)] << (index_bit_size + blockoffset_size)) | (set << blockoffset_size);
+    }
+    bool is_exclusive(uint32_t set, uint32_t way) const { return (exclusive_bits[set * bitmap_words + way / 64] >> (way % 64)) & 1; }
+    void set_exclusive(uint32_t set, uint32_t way, bool exclusive) {
+        uint64_t bit = (uint64_t)1 << (way % 64);
+        if (exclusive) { exclusive_bits[set * bitmap_words + way / 64] |= bit; }
+        else { exclusive_bits[set * bitmap_words + way / 64] &= ~bit; }
+    }
     void print_cache_stats();
     void print_cache_measurements();
-
-    bool searchStreamBuffer(uint32_t addr, streamBuffer* streamBuffer);
-    void initializeStreamBuffer(uint32_t addr, streamBuffer* streamBuffer);
-    void updateStreamBuffer(uint32_t addr, streamBuffer* streamBuffer);
+    void state_spans(std::vector<state_span_t>& spans);     // Checkpointed state, see Checkpoint.h
+    void register_stats();          // Counters in print_level_measurements order
+    void track_owners(uint32_t num_cores);
+
+    bool searchStreamBuffer(uint32_t addr, uint32_t& index);
+    void initializeStreamBuffer(uint32_t addr);
+    void updateStreamBuffer(uint32_t addr, uint32_t index);
+    void prefetchBlocks(uint32_t first, uint32_t last);
+    void prefetch_demand(uint32_t set, uint32_t way, uint32_t addr, bool hit);
+    void prefetch_into_cache(uint32_t block);
+    bool is_prefetched(uint32_t set, uint32_t way) const { return (prefetched_bits[set * bitmap_words + way / 64] >> (way % 64)) & 1; }
+    void set_prefetched(uint32_t set, uint32_t way, bool prefetched) {
+        uint64_t bit = (uint64_t)1 << (way % 64);
+        if (prefetched) { prefetched_bits[set * bitmap_words + way / 64] |= bit; }
+        else { prefetched_bits[set * bitmap_words + way / 64] &= ~bit; }
+    }
     void printStreamBuffer();
 };
+
+void open_event_trace(const char *event_file);      // Exits if tracing is not compiled in
  
 
 
@@ -0,0 +1,75 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*  Checkpoints: the complete state of a hierarchy, for warm starts
+
+    ./sim --checkpoint <file> [--checkpoint-at N] <usual arguments>
+    ./sim --restore <file> <usual arguments>
+
+    --checkpoint writes the state after the first N requests of the trace
+    (default: after the whole trace) and carries on simulating. --restore
+    maps a checkpoint, copies it into a hierarchy of the same configuration
+    and continues the trace from the request after the snapshot; the
+    statistics then include the requests before it.
+
+    Every stateful object lists its state as raw spans (state_spans()):
+    tags, valid/dirty bitmaps, replacement state, stream buffers or the
+    prefetch engine's tables, and the counters. Save writes the spans in
+    order, restore copies them back, so adding state to a class only means
+    listing it there.
+
+    File layout: checkpoint_header_t, then per level a checkpoint_level_t
+    followed by its spans, each a uint64_t byte count and the bytes padded
+    to a multiple of 8.
+*/
+#define CHECKPOINT_MAGIC     0x504B4353u     // "SCKP"
+#define CHECKPOINT_VERSION   2       // 2: 64-bit counters
+
+typedef
+struct {
+   void *data;
+   size_t bytes;
+} state_span_t;
+
+template<class T> void state_span(std::vector<state_span_t>& spans, std::vector<T>& values){
+   state_span_t span = { values.data(), values.size() * sizeof(T) };
+   spans.push_back(span);
+}
+
+template<class T> void state_value(std::vector<state_span_t>& spans, T& value){
+   state_span_t span = { &value, sizeof(T) };
+   spans.push_back(span);
+}
+
+typedef
+struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t num_levels;
+   uint32_t reserved;
+   uint64_t trace_offset;      // Requests simulated before the snapshot
+} checkpoint_header_t;
+
+// Configuration a level must match to be restored
+typedef
+struct {
+   uint32_t BLOCKSIZE;
+   uint32_t SIZE;
+   uint32_t ASSOC;
+   uint32_t POLICY;
+   uint32_t PREFETCHER;
+   uint32_t PREF_N;            // 0 == no prefetcher
+   uint32_t PREF_M;
+   uint32_t num_spans;
+} checkpoint_level_t;
+
+class cache_hierarchy;
+
+// Both print why and return false on failure
+bool checkpoint_save(const char *file, cache_hierarchy& hierarchy, uint64_t trace_offset);
+bool checkpoint_restore(const char *file, cache_hierarchy& hierarchy, uint64_t& trace_offset);
+
+#endif
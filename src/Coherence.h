@@ -0,0 +1,78 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include "Cache.h"
+
+/*  Coherence between the private L1s of a multi-core run (see Multicore.h)
+
+    ./sim --cores --coherence msi|mesi [--directory] ...
+
+    Each L1 block is Modified (dirty), Exclusive (clean, only copy; MESI
+    only) or Shared (clean, possibly one of several copies); an invalid
+    way is I. Every L1 request is checked against the other cores first:
+       read miss          other copies drop to S; an M or E holder supplies
+                          the block (intervention), M writing it back first
+       write miss         other copies are invalidated; an M holder
+                          supplies the block (intervention)
+       write hit on S     upgrade miss: other copies are invalidated
+       write hit on E     silently becomes M (MESI)
+    MSI has no E, so the first write to every clean block is an upgrade.
+
+    Snooping broadcasts each of those checks to every other core. With
+    --directory a sharer bit mask per block (up to DIRECTORY_MAX_CORES)
+    sends them only to the cores holding a copy. Probes counts the remote
+    lookups either way, which is the broadcast cost the directory avoids.
+
+    The private levels must not prefetch: prefetched blocks would arrive
+    without a coherence check.
+*/
+#define DIRECTORY_MAX_CORES 64
+
+enum coherence_t {
+   COHERENCE_NONE,
+   COHERENCE_MSI,
+   COHERENCE_MESI
+};
+
+// Per requesting core
+typedef
+struct {
+   uint64_t upgrades;          // Writes that hit a block in S
+   uint64_t interventions;     // Misses supplied by another core's M or E copy
+   uint64_t invalidations;     // Copies this core's writes removed from other caches
+   uint64_t probes;            // Remote L1 lookups made for this core
+} coherence_stats_t;
+
+class coherence_controller{
+    public:
+    coherence_t protocol;
+    bool directory;
+    std::vector<cache*> caches;                         // One private L1 per core
+    std::vector<coherence_stats_t> stats;
+    std::unordered_map<uint32_t, uint64_t> sharers;     // --directory: block number -> bit per core with a copy
+
+    coherence_controller(coherence_t protocol, bool directory, const std::vector<cache*>& caches);
+
+    // Resolve the request against the other cores, then run it on core's L1
+    void request(uint32_t core, uint32_t addr, char rw);
+    // Called by the L1 when a fill replaces a valid block
+    void on_evict(uint32_t core, uint32_t addr);
+    void print_measurements();
+    void register_stats(stats_registry& registry) const;     // Per-core counters, group "coherence"
+
+    private:
+    uint32_t block_number(uint32_t addr) const { return addr >> this->caches[0]->blockoffset_size; }
+    void remote_caches(uint32_t core, uint32_t addr, std::vector<uint32_t>& remote);
+    bool read_miss(uint32_t core, uint32_t addr);
+    void invalidate_others(uint32_t core, uint32_t addr, bool held);
+    std::vector<uint32_t> remote;       // Scratch for remote_caches()
+};
+
+// "none", "msi" or "mesi"
+bool parse_coherence(const char *name, coherence_t& protocol);
+const char *coherence_name(coherence_t protocol);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+#include <cstdint>
+
+/*  Cache event tracing
+
+    Built only with "make EVENTS=1" (defines TRACE_EVENTS) and then enabled
+    at run time with --events <file>. In a normal build TRACE_EVENT() expands
+    to nothing, so the request path carries no tracing code at all.
+
+    Each thread appends events to its own buffer of EVENT_BUFFER_SIZE
+    records; a full buffer is written to the file in one block under a lock,
+    and the rest is written when the thread exits. The buffer is flushed
+    rather than wrapped as a ring, so no event is dropped. Records from
+    different threads (sweep workers) are told apart by their thread field.
+
+    EV_HIT and EV_MISS fire for every request a level receives: demand
+    reads and writes at L1, and below it the misses, prefetches ('p') and
+    writebacks ('w') of the level above, not only demand traffic.
+
+    File layout: event_file_header_t, then event_record_t records.
+*/
+#define EVENT_MAGIC         0x54564553u     // "SEVT"
+#define EVENT_VERSION       1
+#define EVENT_BUFFER_SIZE   (1 << 16)       // Records per thread buffer
+#define EVENT_NO_WAY        0xFFFFFFFFu     // way of events not tied to a cache way (stream buffer prefetches)
+
+enum event_type_t {
+   EV_HIT = 0,          // Request to this level hit; addr is the request address
+   EV_MISS,             // Request to this level missed; addr is the request address
+   EV_FILL,             // Block installed in set/way
+   EV_EVICT,            // Valid block replaced in set/way
+   EV_WRITEBACK,        // Dirty block written to the level below
+   EV_PREFETCH,         // Prefetch issued for the block
+   EV_CONFIG            // Sweep worker starts a configuration; addr is its index in the grid
+};
+
+typedef
+struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t record_size;
+   uint32_t reserved;
+} event_file_header_t;
+
+typedef
+struct {
+   uint32_t addr;
+   uint32_t set;
+   uint32_t way;
+   uint8_t type;        // event_type_t
+   uint8_t level;       // 1 == L1, 2 == L2
+   uint16_t thread;     // Threads are numbered from 0 in order of their first event
+} event_record_t;
+
+// Start writing events to file; false (and nothing traced) if it cannot be created
+bool event_trace_open(const char *file);
+void event_trace_close();
+void event_record(event_type_t type, uint32_t level, uint32_t set, uint32_t way, uint32_t addr);
+
+#ifdef TRACE_EVENTS
+#define TRACE_EVENT(type, level, set, way, addr) event_record((type), (level), (set), (way), (addr))
+#else
+#define TRACE_EVENT(type, level, set, way, addr) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+#include <cstdint>
+
+#include "Cache.h"
+
+/*  Cache geometries for cache::request_impl
+
+    runtime_geometry reads the shifts, masks and associativity from the
+    cache at every access. fixed_geometry<BlockSize, Sets, Assoc> bakes
+    them in as constants so the address split folds to a shift and a mask.
+    Below FIXED_KERNEL_WAYS ways the tag compare is an unrolled scalar loop,
+    which beats a call to the way-match kernel (see WayMatch.h); wider sets
+    call the kernel, whose AVX2/SSE2 compare wins there. The cache
+    constructor picks a fixed instantiation when its geometry is in
+    FIXED_GEOMETRIES (see sim.cc) and falls back to runtime_geometry
+    otherwise; runtime_geometry always uses the kernel.
+*/
+#define FIXED_KERNEL_WAYS   16
+constexpr uint32_t const_log2(uint32_t n){ return n <= 1 ? 0 : 1 + const_log2(n / 2); }
+
+struct runtime_geometry{
+    static uint32_t index(cache& c, uint32_t addr){ return c.parse_index(addr); }
+    static uint32_t tag(cache& c, uint32_t addr){ return c.parse_tag(addr); }
+    static bool lookup(cache& c, uint32_t set, uint32_t tag, uint32_t& way){ return c.lookup(set, tag, way); }
+};
+
+template<uint32_t BlockSize, uint32_t Sets, uint32_t Assoc>
+struct fixed_geometry{
+    static_assert((BlockSize & (BlockSize - 1)) == 0 && (Sets & (Sets - 1)) == 0, "power-of-two geometry");
+    static_assert(Assoc >= 1 && Assoc <= 64, "one valid-bitmap word per set");
+
+    static const uint32_t offset_bits = const_log2(BlockSize);
+    static const uint32_t index_bits = const_log2(Sets);
+
+    static uint32_t index(cache& c, uint32_t addr){ (void) c; return (addr >> offset_bits) & (Sets - 1); }
+    static uint32_t tag(cache& c, uint32_t addr){ (void) c; return addr >> (offset_bits + index_bits); }
+
+    static const bool uses_kernel = Assoc >= FIXED_KERNEL_WAYS;
+
+    // Same result as cache::lookup, for a set that fits one bitmap word
+    static bool lookup(cache& c, uint32_t set, uint32_t tag, uint32_t& way){
+        const uint32_t *set_tags = &c.tags[set * Assoc];
+        uint64_t valid = c.valid_bits[set];
+        uint64_t match, invalid;
+        if (uses_kernel) {
+            way_masks_t masks = c.match_ways(set_tags, valid, Assoc, tag);
+            match = masks.hit;
+            invalid = masks.invalid;
+        } else {
+            match = 0;
+            for (uint32_t i = 0; i < Assoc; i++) {
+                match |= (uint64_t)(set_tags[i] == tag) << i;
+            }
+            match &= valid;
+            const uint64_t all_ways = (Assoc == 64) ? ~(uint64_t)0 : (((uint64_t)1 << Assoc) - 1);
+            invalid = ~valid & all_ways;
+        }
+        if (match != 0) {
+            way = __builtin_ctzll(match);
+            return true;
+        }
+        way = (invalid != 0) ? (uint32_t)__builtin_ctzll(invalid) : c.policy->victim(set);
+        return false;
+    }
+};
+
+#endif
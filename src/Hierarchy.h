@@ -0,0 +1,82 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+#include <cstdint>
+#include <vector>
+#include <string>
+
+#include "Cache.h"
+
+/*  Cache hierarchies
+
+    The classic command line describes at most two levels sharing one block
+    size: L1 plus an L2 if L2_SIZE != 0, with the prefetcher on the last level.
+    Deeper hierarchies are described one level at a time, L1 first:
+
+       ./sim --hierarchy <config_file> <trace_file>
+       ./sim --level <spec> [--level <spec> ...] <trace_file>
+
+    A level is NAME BLOCKSIZE SIZE ASSOC [POLICY [PREFETCHER PREF_N PREF_M]],
+    whitespace separated on a config file line ('#' starts a comment) and
+    comma separated in a --level spec. For example, a three-level part:
+       L1  32  32768    8
+       L2  64  262144   8   lru
+       L3  64  4194304  16  drrip  stream 4 8
+    Each level sends its misses and writebacks to the level below it; the last
+    level talks to memory. Block sizes may grow going down but not shrink.
+
+    request_batch() runs a block of trace requests one level at a time: L1
+    over HIERARCHY_BATCH_SIZE requests, queueing its misses, writebacks and
+    prefetches in issue order, then L2 over that queue, and so on. The end
+    state and every counter match request() per line; only the order of
+    traced events (make EVENTS=1) would differ, so such builds do not batch.
+*/
+#define HIERARCHY_BATCH_SIZE   1024     // Requests L1 runs before the levels below catch up
+typedef
+struct {
+   std::string NAME;
+   uint32_t BLOCKSIZE;
+   uint32_t SIZE;
+   uint32_t ASSOC;
+   uint32_t POLICY;         // replacement_t
+   uint32_t PREFETCHER;     // prefetcher_t
+   uint32_t PREF_N;         // 0 == no prefetcher
+   uint32_t PREF_M;
+} level_params_t;
+
+class cache_hierarchy{
+    public:
+    std::vector<cache*> levels;     // levels[0] is L1, each linked to the next through level_below
+    cache* L1;
+    cache* L2;      // levels[1], NULL for a single level
+
+    cache_hierarchy(const cache_params_t& params);
+    cache_hierarchy(const std::vector<level_params_t>& level_params);
+    ~cache_hierarchy();
+
+    void request(uint32_t addr, char rw){ this->L1->request(addr, rw); }
+    void request_batch(const trace_request_t *requests, size_t count);
+    void print_contents();          // Every level's sets, then any stream buffers
+    void print_measurements();      // Per-level statistics for any depth
+
+    private:
+    void build(const std::vector<level_params_t>& level_params);
+};
+
+// Generic per-level report: the level's registered stats (see Stats.h)
+void print_level_measurements(const cache *c);
+void print_level_config(const std::vector<level_params_t>& levels);
+// Group "memory": blocks moved to and from memory by the last level
+void register_memory_stats(stats_registry& registry, const cache *last_level);
+
+// The levels the classic parameters describe
+void classic_levels(const cache_params_t& params, std::vector<level_params_t>& levels);
+
+// Parse one level from spec, split at any of separators. Prints why and returns false if malformed.
+bool parse_level_spec(char *spec, const char *separators, level_params_t& level);
+bool parse_hierarchy_file(const char *file, std::vector<level_params_t>& levels);
+
+// Geometry, policy and block size ordering checks; prints the first problem found
+bool valid_hierarchy(const std::vector<level_params_t>& levels);
+bool valid_cache_params(const cache_params_t& params);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef MULTICORE_H
+#define MULTICORE_H
+#include <cstdint>
+#include <vector>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Coherence.h"
+#include "Stats.h"
+
+/*  Multi-core mode: one trace file per simulated core
+
+    ./sim --cores [--interleave rr|time] <BLOCKSIZE> ... <PREF_M> <trace_0> <trace_1> ...
+    ./sim --cores [--interleave rr|time] --hierarchy <file> <trace_0> <trace_1> ...
+    (optionally with --coherence msi|mesi [--directory], see Coherence.h)
+
+    Every core gets a private copy of the first level (L1); the levels below
+    it are shared by all cores, so at least two levels are needed. Requests
+    are interleaved either round-robin (one request per core in turn) or by
+    the traces' timestamp column (lowest first, ties to the lower core). A
+    core drops out when its trace ends.
+
+    Shared levels remember which core filled each block. A fill that evicts
+    a block owned by a different core is an interference eviction, charged
+    to the core that lost the block.
+
+    Without --coherence the private L1s are not kept coherent: each core
+    sees only its own writes, as if the traces touched disjoint data.
+*/
+enum interleave_t {
+   INTERLEAVE_RR,
+   INTERLEAVE_TIME
+};
+
+class multicore_system{
+    public:
+    std::vector<cache*> cores;      // Private L1 per core
+    cache_hierarchy *shared;        // Every level below L1
+    coherence_controller *coherence;        // NULL without --coherence
+
+    multicore_system(const std::vector<level_params_t>& levels, uint32_t num_cores, coherence_t protocol, bool directory);
+    ~multicore_system();
+
+    void request(uint32_t core, uint32_t addr, char rw);
+    void print_contents();
+    void print_measurements();
+};
+
+// "rr" or "time"
+bool parse_interleave(const char *name, interleave_t& interleave);
+int run_multicore(const std::vector<level_params_t>& levels, const std::vector<const char *>& trace_files, interleave_t interleave,
+                  coherence_t protocol, bool directory, const output_params_t& output);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+#include <cstdint>
+#include <vector>
+
+#include "Checkpoint.h"
+
+/*  Prefetchers
+
+    The prefetcher runs at the level PREF_N/PREF_M apply to (L2 when there is
+    one, else L1). The default is the stream buffer unit; the other engines
+    prefetch straight into the cache and are selected with --prefetcher:
+       stream    PREF_N stream buffers of PREF_M consecutive blocks (prefetchUnit)
+       nextline  on a miss to block B, prefetch B + 1 .. B + PREF_M
+       delta     PREF_N-entry table of 64-block regions, each remembering its
+                 last block and delta; once a region repeats a delta it
+                 prefetches PREF_M blocks further along it (the trace has no PCs)
+       markov    PREF_N-entry direct-mapped miss correlation table, each entry
+                 holding the last MARKOV_SUCCESSORS blocks that missed after it;
+                 up to PREF_M of them are prefetched
+
+    Engines are trained on demand misses and on the first demand hit to a
+    prefetched block, so a correct stream keeps running ahead of the misses.
+*/
+enum prefetcher_t {
+   PREF_STREAM = 0,
+   PREF_NEXTLINE,
+   PREF_DELTA,
+   PREF_MARKOV,
+   PREF_COUNT
+};
+
+#define PREFETCH_LATENCY        16      // Demand requests to a cache before a prefetch into it arrives
+#define POLLUTION_FILTER_SIZE   4096    // Blocks evicted by prefetch fills, direct-mapped
+#define DELTA_REGION_BITS       6       // delta tracks regions of 64 blocks
+#define MARKOV_SUCCESSORS       4       // Successors remembered per markov entry
+
+class prefetcher{
+    public:
+    uint32_t table_size;        // PREF_N
+    uint32_t degree;            // PREF_M
+
+    prefetcher(uint32_t table_size, uint32_t degree) : table_size(table_size), degree(degree) {}
+    virtual ~prefetcher() {}
+
+    // Observe a demand access to block and append the blocks to prefetch
+    virtual void train(uint32_t block, std::vector<uint32_t>& candidates) = 0;
+    // Training state a checkpoint must save (see Checkpoint.h); none by default
+    virtual void state_spans(std::vector<state_span_t>& spans) { (void) spans; }
+};
+
+class nextline_prefetcher : public prefetcher{
+    public:
+    nextline_prefetcher(uint32_t table_size, uint32_t degree) : prefetcher(table_size, degree) {}
+    void train(uint32_t block, std::vector<uint32_t>& candidates);
+};
+
+typedef
+struct {
+   uint32_t region;         // block >> DELTA_REGION_BITS
+   uint32_t last_block;
+   int32_t delta;           // Last delta seen in the region
+   bool confirmed;          // delta repeated, so the region is striding
+   bool valid;
+   uint64_t last_use;       // For LRU replacement of entries
+} delta_entry_t;
+
+class delta_prefetcher : public prefetcher{
+    public:
+    std::vector<delta_entry_t> table;
+    uint64_t accesses;
+
+    delta_prefetcher(uint32_t table_size, uint32_t degree);
+    void train(uint32_t block, std::vector<uint32_t>& candidates);
+    void state_spans(std::vector<state_span_t>& spans) { state_span(spans, table); state_value(spans, accesses); }
+};
+
+typedef
+struct {
+   uint32_t block;
+   uint32_t num_successors;
+   uint32_t successors[MARKOV_SUCCESSORS];      // Most recent first
+   bool valid;
+} markov_entry_t;
+
+class markov_prefetcher : public prefetcher{
+    public:
+    std::vector<markov_entry_t> table;
+    uint32_t last_block;
+    bool have_last;
+
+    markov_prefetcher(uint32_t table_size, uint32_t degree);
+    void train(uint32_t block, std::vector<uint32_t>& candidates);
+    void state_spans(std::vector<state_span_t>& spans) { state_span(spans, table); state_value(spans, last_block); state_value(spans, have_last); }
+};
+
+// NULL for PREF_STREAM, which the cache implements with its stream buffers
+prefetcher* make_prefetcher(prefetcher_t type, uint32_t table_size, uint32_t degree);
+
+// "stream", "nextline", "delta", "markov"
+bool parse_prefetcher(const char *name, prefetcher_t& type);
+const char* prefetcher_name(prefetcher_t type);
+
+#endif
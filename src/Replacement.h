@@ -0,0 +1,146 @@
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+#include <cstdint>
+#include <vector>
+
+#include "Checkpoint.h"
+
+/*  Replacement policies
+
+    A cache asks its policy for a victim only when every way of the set is
+    valid (invalid ways are always filled first, lowest way first). Each
+    policy keeps its own metadata in flat per-set arrays sized for it:
+       lru     doubly linked recency list per set (8 bytes per way)
+       plru    tree pseudo-LRU, assoc - 1 bits per set (power-of-two assoc)
+       srrip   static re-reference interval prediction, 2-bit RRPV per way
+       brrip   bimodal RRIP: inserts at distant RRPV except 1 in 32 fills
+       drrip   set dueling between SRRIP and BRRIP leader sets, 10-bit PSEL
+               (caches of fewer than 4 sets have nothing to duel: SRRIP)
+       random  no per-set state, one xorshift generator per cache
+*/
+enum replacement_t {
+   REPL_LRU = 0,
+   REPL_PLRU,
+   REPL_SRRIP,
+   REPL_BRRIP,
+   REPL_DRRIP,
+   REPL_RANDOM,
+   REPL_COUNT
+};
+
+class replacement_policy{
+    public:
+    uint32_t num_sets;
+    uint32_t assoc;
+
+    replacement_policy(uint32_t num_sets, uint32_t assoc) : num_sets(num_sets), assoc(assoc) {}
+    virtual ~replacement_policy() {}
+
+    virtual void on_hit(uint32_t set, uint32_t way) = 0;
+    // A block was installed in way; replacing is true if a valid block was evicted from it
+    virtual void on_fill(uint32_t set, uint32_t way, bool replacing) = 0;
+    // The block in way was dropped without a replacement (coherence invalidation)
+    virtual void on_invalidate(uint32_t set, uint32_t way) { (void) set; (void) way; }
+    // Way to evict from a set whose ways are all valid
+    virtual uint32_t victim(uint32_t set) = 0;
+    // Ways of a set from most to least protected, for the contents dump
+    virtual void order(uint32_t set, std::vector<uint32_t>& ways);
+    // Everything a checkpoint must save (see Checkpoint.h)
+    virtual void state_spans(std::vector<state_span_t>& spans) = 0;
+};
+
+#define LRU_NONE 0xFFFFFFFFu
+
+typedef
+struct {
+   uint32_t prev;       // Next more recently used way, LRU_NONE at the head
+   uint32_t next;       // Next less recently used way, LRU_NONE at the tail
+} lru_link_t;
+
+// True LRU: the valid ways of each set form a doubly linked list from
+// head (MRU) to tail (LRU), so promotion and victim choice are O(1).
+class lru_policy : public replacement_policy{
+    public:
+    std::vector<lru_link_t> links;      // Per slot
+    std::vector<uint32_t> head;         // Per set
+    std::vector<uint32_t> tail;         // Per set
+
+    lru_policy(uint32_t num_sets, uint32_t assoc);
+    void on_hit(uint32_t set, uint32_t way);
+    void on_fill(uint32_t set, uint32_t way, bool replacing);
+    void on_invalidate(uint32_t set, uint32_t way) { unlink(set, way); }
+    uint32_t victim(uint32_t set);
+    void order(uint32_t set, std::vector<uint32_t>& ways);
+    void state_spans(std::vector<state_span_t>& spans) { state_span(spans, links); state_span(spans, head); state_span(spans, tail); }
+
+    private:
+    void unlink(uint32_t set, uint32_t way);
+    void push_front(uint32_t set, uint32_t way);
+};
+
+// Tree pseudo-LRU: node n of a set's tree has children 2n+1 and 2n+2; its bit
+// points to the half holding the next victim.
+class plru_policy : public replacement_policy{
+    public:
+    std::vector<uint64_t> bits;         // words_per_set words per set
+    uint32_t words_per_set;
+
+    plru_policy(uint32_t num_sets, uint32_t assoc);
+    void on_hit(uint32_t set, uint32_t way) { touch(set, way); }
+    void on_fill(uint32_t set, uint32_t way, bool replacing) { (void) replacing; touch(set, way); }
+    uint32_t victim(uint32_t set);
+    void state_spans(std::vector<state_span_t>& spans) { state_span(spans, bits); }
+
+    private:
+    void touch(uint32_t set, uint32_t way);
+    bool get_bit(uint32_t set, uint32_t node) const { return (bits[set * words_per_set + node / 64] >> (node % 64)) & 1; }
+    void put_bit(uint32_t set, uint32_t node, bool value);
+};
+
+#define RRPV_MAX        3       // 2-bit re-reference prediction values
+#define BRRIP_EPSILON   32      // BRRIP inserts at RRPV_MAX - 1 once per this many fills
+#define DRRIP_LEADERS   32      // Leader sets per competing policy
+#define DRRIP_MIN_STRIDE 4      // Smallest constituency: two leaders, two followers
+#define DRRIP_PSEL_MAX  1023    // 10-bit policy selector
+
+// SRRIP, BRRIP and DRRIP share the RRPV array and victim search; they differ
+// only in the insertion RRPV.
+class rrip_policy : public replacement_policy{
+    public:
+    std::vector<uint8_t> rrpv;          // Per slot
+    replacement_t mode;                 // REPL_SRRIP, REPL_BRRIP or REPL_DRRIP
+    uint32_t brrip_fills;               // Fill counter for BRRIP's 1-in-EPSILON long insertion
+    uint32_t psel;                      // DRRIP: >= midpoint selects BRRIP for follower sets
+    uint32_t leader_stride;             // DRRIP: sets per leader constituency (0 == no dueling)
+
+    rrip_policy(uint32_t num_sets, uint32_t assoc, replacement_t mode);
+    void on_hit(uint32_t set, uint32_t way) { rrpv[set * assoc + way] = 0; }
+    void on_fill(uint32_t set, uint32_t way, bool replacing);
+    uint32_t victim(uint32_t set);
+    void order(uint32_t set, std::vector<uint32_t>& ways);
+    void state_spans(std::vector<state_span_t>& spans) { state_span(spans, rrpv); state_value(spans, brrip_fills); state_value(spans, psel); }
+
+    private:
+    uint8_t brrip_insertion();
+};
+
+class random_policy : public replacement_policy{
+    public:
+    uint64_t state;                     // xorshift64 state
+
+    random_policy(uint32_t num_sets, uint32_t assoc) : replacement_policy(num_sets, assoc), state(0x9E3779B97F4A7C15ULL) {}
+    void on_hit(uint32_t set, uint32_t way) { (void) set; (void) way; }
+    void on_fill(uint32_t set, uint32_t way, bool replacing) { (void) set; (void) way; (void) replacing; }
+    uint32_t victim(uint32_t set);
+    void state_spans(std::vector<state_span_t>& spans) { state_value(spans, state); }
+};
+
+replacement_policy* make_replacement_policy(replacement_t type, uint32_t num_sets, uint32_t assoc);
+
+// "lru", "plru", "srrip", "brrip", "drrip", "random"
+bool parse_replacement(const char *name, replacement_t& type);
+const char* replacement_name(replacement_t type);
+// plru needs a power-of-two associativity; the others take any
+bool replacement_supports(replacement_t type, uint32_t assoc);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef SAMPLING_H
+#define SAMPLING_H
+#include <cstdint>
+#include <vector>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+
+/*  Sampled simulation: estimate the counters from part of the sets and/or part of the trace
+
+    ./sim --sample-sets K [--sample-time PERIOD,WINDOW,WARMUP] [--validate] <usual arguments>
+
+    Set sampling simulates only the requests whose address falls in one of
+    roughly 1 in K set groups. A group is a value of the address bits that
+    every level uses as set index bits, so the chosen groups select whole
+    sets at every level of the hierarchy; groups are picked by a hash so
+    strided access patterns do not line up with them.
+
+    Time sampling simulates WARMUP + WINDOW requests out of every PERIOD:
+    the first WARMUP only warm the caches, the next WINDOW are measured, the
+    rest are skipped.
+
+    Each counter is extrapolated from the measured sample units (set groups,
+    or time windows when only time sampling is used) with a 95% confidence
+    interval from the spread between units (Student t, finite population
+    corrected). When both are used the interval only reflects the spread
+    between set groups. Prefetch counters are the least reliable: stream
+    buffers follow addresses across set groups.
+
+    With --validate the full hierarchy is simulated alongside and each
+    estimate is reported next to the exact count.
+*/
+#define SAMPLE_MAX_KEY_BITS 24      // Index bits hashed to pick set groups
+
+typedef
+struct {
+   uint32_t SET_RATE;      // Simulate about 1 in SET_RATE set groups; 0 == all sets
+   uint32_t PERIOD;        // 0 == no time sampling
+   uint32_t WINDOW;
+   uint32_t WARMUP;
+} sample_params_t;
+
+class sampled_simulation{
+    public:
+    sample_params_t params;
+    cache_hierarchy hierarchy;
+
+    // Set sampling: group key = SAMPLE_MAX_KEY_BITS or fewer address bits at key_shift
+    uint32_t key_shift;
+    uint32_t key_bits;
+    std::vector<int32_t> key_unit;      // Per key: its sample unit, -1 if not sampled
+
+    uint64_t requests;                  // Trace requests seen
+    uint64_t measured_positions;        // Requests in measured windows (all of them without time sampling)
+    uint64_t simulated;                 // Requests actually simulated
+    std::vector<std::vector<uint64_t> > units;      // Counter totals per sample unit
+    std::vector<uint64_t> before;
+    std::vector<uint64_t> after;
+
+    sampled_simulation(const std::vector<level_params_t>& levels, const sample_params_t& params);
+
+    void request(uint32_t addr, char rw);
+    // Extrapolated total of counter and the half width of its 95% confidence interval
+    void estimate(uint32_t counter, double& total, double& half_width) const;
+    void print_report(const cache_hierarchy *exact) const;
+
+    private:
+    void measure(uint32_t unit, uint32_t addr, char rw);
+};
+
+// Counters sampled per level, then memory traffic
+uint32_t sample_counter_count(const cache_hierarchy& hierarchy);
+void sample_counters(const cache_hierarchy& hierarchy, std::vector<uint64_t>& counters);
+
+// "PERIOD,WINDOW,WARMUP"
+bool parse_sample_time(const char *spec, sample_params_t& params);
+int run_sampled(const std::vector<level_params_t>& levels, const char *trace_file, const sample_params_t& params, bool validate);
+
+#endif
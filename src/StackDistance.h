@@ -0,0 +1,44 @@
+#ifndef STACK_DISTANCE_H
+#define STACK_DISTANCE_H
+#include <cstdint>
+#include <vector>
+
+#include "Trace.h"
+
+/*  Stack distance mode: LRU miss counts for every cache size in one pass per set count
+
+    ./sim --stack-distance [--max-size BYTES] [--verify] <BLOCKSIZE> <trace_file> [output_csv]
+
+    A request's stack distance is the number of distinct blocks of its set
+    touched since the previous request to the same block (Mattson et al.).
+    An LRU cache with that many sets hits exactly when the distance is
+    below its associativity, so one histogram per set count gives the
+    misses of every associativity, and the one-set histogram gives every
+    fully associative size. Distances come from a Fenwick tree over each
+    set's request positions in O(log n) per request.
+
+    One CSV row is written for every power-of-two set count and
+    associativity with SIZE <= max-size (default 1 MiB). Misses count
+    reads and writes, like the L1 miss rate of the normal output. With
+    --verify every row is also simulated with cache::request and any
+    disagreement is an error.
+*/
+#define STACK_DEFAULT_MAX_SIZE  (1u << 20)
+
+// Distance histogram of one set count
+typedef
+struct {
+   uint32_t sets;
+   uint64_t cold;                       // First touches of a block: a miss at every size
+   std::vector<uint64_t> distance;      // distance[d]: reuses at stack distance d, d < max_assoc
+   uint64_t far;                        // Reuses at stack distance >= max_assoc
+} stack_profile_t;
+
+// blocks[i] is request i's block number; ids[i] numbers the distinct blocks 0 .. num_ids - 1
+void stack_profile(const std::vector<uint32_t>& blocks, const std::vector<uint32_t>& ids, uint32_t num_ids,
+                   uint32_t sets, uint32_t max_assoc, stack_profile_t& profile);
+uint64_t stack_misses(const stack_profile_t& profile, uint32_t assoc);
+
+int run_stack_distance(int argc, char *argv[]);
+
+#endif
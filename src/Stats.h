@@ -0,0 +1,64 @@
+#ifndef STATS_H
+#define STATS_H
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <functional>
+
+/*  Stats registry and machine-readable output
+
+    Each cache registers its 64-bit counters in a stats_registry under a
+    snake_case key (JSON/CSV) and a label (text report); the counters stay
+    plain members the request path increments directly. Derived values
+    such as the miss rate are registered as rates. The generic per-level
+    report and both machine-readable formats walk the registries, so a
+    registered counter shows up in all of them.
+
+       --format text   the usual report (default); --no-contents drops the per-set dump
+       --format json   one object: the trace file(s), every level with its
+                       configuration, stats and (with --contents) its
+                       per-set contents, then the other groups (memory,
+                       timing, coherence)
+       --format csv    "group,stat,value" rows, each level's configuration first
+*/
+enum stats_format_t {
+   FORMAT_TEXT,
+   FORMAT_JSON,
+   FORMAT_CSV
+};
+
+typedef
+struct {
+   stats_format_t FORMAT;
+   bool CONTENTS;          // Per-set contents dump; text default on, json default off
+} output_params_t;
+
+typedef
+struct {
+   std::string key;                    // JSON key / CSV stat
+   std::string label;                  // Text label, colon included
+   const uint64_t *counter;            // NULL for a rate
+   std::function<double()> rate;
+} stat_entry_t;
+
+class stats_registry{
+    public:
+    std::string group;                  // "L1", "memory", "timing", ...
+    std::vector<stat_entry_t> entries;
+
+    void counter(const std::string& key, const std::string& label, const uint64_t& value);
+    void rate(const std::string& key, const std::string& label, std::function<double()> value);
+    void print_text() const;            // One "label value" line per entry
+};
+
+class cache;
+
+// "text", "json" or "csv"
+bool parse_stats_format(const char *name, stats_format_t& format);
+
+// JSON or CSV report of caches (configuration, stats, optionally contents) followed by groups
+void write_stats(FILE *out, stats_format_t format, const std::vector<const char *>& trace_files,
+                 const std::vector<cache*>& caches, const std::vector<const stats_registry*>& groups, bool contents);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+#include <cstdint>
+#include <vector>
+#include <string>
+
+#include "Cache.h"
+#include "Trace.h"
+
+/*  Sweep mode: simulate a grid of configurations against one decoded trace.
+
+    ./sim --sweep [--threads N] [--events file] <grid_file> <trace_file> [output_csv]
+
+    Each non-comment line of the grid file holds the seven numeric
+    command-line parameters in the usual order, optionally followed by the
+    L1 and L2 replacement policy names (default lru) and the prefetcher
+    (default stream):
+       BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M [L1_POLICY [L2_POLICY [PREFETCHER]]]
+    Any field may be a comma separated list; the line expands to every
+    combination of its fields. One CSV row is written per configuration.
+
+    With --threads N (0 = one per core) the configurations are simulated by N worker threads
+    sharing the decoded trace read-only; rows are still written in grid order,
+    so the output is identical to a serial run. With --events (see Events.h)
+    each worker marks the start of every configuration with an EV_CONFIG event.
+*/
+int run_sweep(int argc, char *argv[]);
+
+bool parse_sweep_grid(const char *grid_file, std::vector<cache_params_t>& configs);
+std::string sweep_csv_header();
+std::string simulate_sweep_config(const cache_params_t& params, const std::vector<trace_request_t>& trace);
+void run_sweep_configs(const std::vector<cache_params_t>& configs, const std::vector<trace_request_t>& trace,
+                       unsigned num_threads, std::vector<std::string>& rows);
+
+#endif
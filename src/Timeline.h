@@ -0,0 +1,70 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+
+/*  Interval statistics: a per-phase timeline of the run
+
+    ./sim --timeline <file> [--interval K] [--phase-threshold T] <usual arguments>
+
+    Every K requests (default 10000) the counters of every level are
+    snapshotted and the change since the previous snapshot is written to
+    <file> as one CSV row: the trace position the interval ends at, then
+    per level reads, misses (read and write), writebacks and prefetches,
+    then memory traffic. A last, shorter row covers the end of the trace.
+    Between snapshots the cost is one compare per request.
+
+    The report then lists the run's phases. An interval's signature is
+    each level's misses and the memory traffic per request; a phase ends
+    where two intervals in a row differ from the mean signature of the
+    phase so far by more than T (default 0.5) relative to it; a phase is
+    at least two intervals long. Each phase
+    gets its representative interval, the one closest to the phase mean:
+    a window to hand to --sample-time or --checkpoint-at.
+*/
+#define TIMELINE_DEFAULT_INTERVAL   10000
+#define TIMELINE_DEFAULT_THRESHOLD  0.5
+#define TIMELINE_MIN_PHASE          2       // Intervals
+
+typedef
+struct {
+   const char *FILE_NAME;
+   uint64_t INTERVAL;
+   double THRESHOLD;
+} timeline_params_t;
+
+// Counters sampled per level, in column order
+#define TIMELINE_LEVEL_COUNTERS 4
+
+class interval_timeline{
+    public:
+    timeline_params_t params;
+    std::vector<cache*> caches;
+    FILE *out;
+
+    uint64_t start;                     // Trace position of the first request timed
+    uint64_t next;                      // Position of the next snapshot
+    uint64_t last_position;
+    std::vector<uint64_t> last;         // Counters at the previous snapshot
+    std::vector<uint64_t> ends;         // Per interval: trace position it ends at
+    std::vector<std::vector<double> > signatures;   // Per interval: misses per level, then memory traffic, per request
+
+    // Baseline is the hierarchy's counters now, at trace position start (non-zero after --restore)
+    interval_timeline(cache_hierarchy& hierarchy, const timeline_params_t& params, uint64_t start);
+    ~interval_timeline();
+
+    // Call with the number of requests simulated so far
+    void tick(uint64_t position){ if (position == this->next) { this->snapshot(position); } }
+    void snapshot(uint64_t position);
+    void finish(uint64_t position);     // Final partial interval; closes the file
+    void print_phases(FILE *report);
+
+    private:
+    void read_counters(std::vector<uint64_t>& counters) const;
+};
+
+#endif
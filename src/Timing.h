@@ -0,0 +1,101 @@
+#ifndef TIMING_H
+#define TIMING_H
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+
+/*  Timing model: latency per request, AMAT and a cycle estimate
+
+    ./sim --timing [--hit-latency L1,L2,...] [--mshrs N] [--dram LATENCY,INTERVAL] <usual arguments>
+
+    Any of the options turns the model on. The core issues one request per
+    cycle without waiting for earlier ones, so misses overlap. A request
+    walks down the levels as the functional simulation would serve it:
+    each level adds its hit latency; a level that misses takes one of its
+    MSHRs until the block returns (the core stalls while the L1 has none
+    free); a request to a block that already has an outstanding miss at a
+    level merges with it and waits for that fill. The last level's misses
+    queue for one DRAM channel that starts a block every INTERVAL cycles
+    and returns it LATENCY cycles later. Writebacks to memory take channel
+    slots too.
+
+    Prefetches (stream buffers or engines) are timed the same way from the
+    level below the prefetching one, but do not take MSHRs. A demand for a
+    prefetched block that has not arrived waits for it: that is a late
+    prefetch. The simulated cycles are the completion time of the last
+    request. After --restore the timing covers only the resumed requests.
+*/
+#define TIMING_DEFAULT_MSHRS          8
+#define TIMING_DEFAULT_DRAM_LATENCY   100
+#define TIMING_DEFAULT_DRAM_INTERVAL  4
+#define TIMING_HISTOGRAM_BUCKETS      24      // Latencies 0, 1, 2-3, 4-7, ... 2^22 and up
+#define TIMING_PURGE_SIZE             4096    // Prefetches in flight kept before arrived ones are dropped
+
+typedef
+struct {
+   std::vector<uint32_t> HIT_LATENCY;       // Per level, L1 first
+   uint32_t MSHRS;
+   uint32_t DRAM_LATENCY;
+   uint32_t DRAM_INTERVAL;
+} timing_params_t;
+
+typedef
+struct {
+   uint32_t block;
+   uint64_t ready;          // Cycle the fill returns; the entry is free from then on
+} mshr_entry_t;
+
+// Per level
+typedef
+struct {
+   uint32_t hit_latency;
+   std::vector<mshr_entry_t> mshrs;
+   std::unordered_map<uint32_t, uint64_t> prefetches;    // Block -> cycle it arrives
+   uint64_t served;                 // Demand requests this level supplied
+   uint64_t merges;                 // Requests that joined an outstanding miss
+   uint64_t mshr_stall_cycles;
+} timing_level_t;
+
+class timing_model{
+    public:
+    timing_params_t params;
+    std::vector<cache*> caches;
+    std::vector<timing_level_t> levels;
+
+    uint64_t now;                   // Issue cycle of the current request
+    uint64_t next_issue;
+    uint64_t dram_free;             // First cycle the DRAM channel can start a block
+    uint64_t dram_blocks;           // Transfers this model put on the channel for the current request
+    uint64_t finish;                // Latest completion so far
+    uint64_t requests;
+    uint64_t memory_served;
+    uint64_t total_latency;
+    uint64_t histogram[TIMING_HISTOGRAM_BUCKETS];
+    uint64_t prefetch_timely;       // Demands for prefetched blocks that had arrived
+    uint64_t prefetch_late;         // ... that had not
+    uint64_t prefetch_wait_cycles;
+
+    timing_model(cache_hierarchy& hierarchy, const timing_params_t& params);
+
+    // Time the request, then simulate it
+    void request(uint32_t addr, char rw);
+    // Called by a level as it issues a prefetch for block
+    void on_prefetch(const cache *level, uint32_t block);
+    void print_measurements();
+    void register_stats(stats_registry& registry) const;     // Group "timing"
+
+    private:
+    uint64_t service(uint32_t first, uint32_t addr, uint64_t t, bool demand);
+    uint64_t dram(uint64_t t);
+};
+
+// Default hit latencies for the levels --hit-latency did not cover
+void timing_level_defaults(timing_params_t& params, uint32_t num_levels);
+// "L1,L2,..." and "LATENCY,INTERVAL"
+bool parse_hit_latency(const char *spec, timing_params_t& params);
+bool parse_dram_timing(const char *spec, timing_params_t& params);
+
+#endif
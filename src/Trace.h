@@ -0,0 +1,188 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+// One decoded trace line: "r <hex addr>" or "w <hex addr>"
+typedef
+struct {
+   uint32_t addr;
+   char rw;
+} trace_request_t;
+
+/*  Buffered reader for "r|w <hex addr>" text traces
+
+    Reads the file in large chunks and decodes addresses eight characters
+    at a time (SWAR) instead of going through fscanf. Unlike the old
+    fscanf loop, a request type other than 'r'/'w' or a malformed address
+    is reported as an error rather than silently accepted or ending the run.
+    A request may carry a decimal timestamp after its address ("r 1fa0 1234");
+    the multi-core driver can interleave traces by it. Anything else before
+    the end of the line is reported as a malformed timestamp.
+
+    gzip and zstd compressed traces are detected from their magic bytes and
+    decompressed on the fly (zstd needs a build with "make ZSTD=1").
+*/
+#define TRACE_TEXT_CHUNK   (1 << 20)    // Bytes per read()
+#define TRACE_TEXT_WINDOW  64           // Bytes kept buffered ahead of each request
+#define TRACE_TEXT_PAD     16           // Sentinel bytes after the valid data
+
+enum trace_compression_t {
+   TRACE_PLAIN,
+   TRACE_GZIP,
+   TRACE_ZSTD
+};
+
+enum trace_status_t {
+   TRACE_ERROR = -1,
+   TRACE_EOF   = 0,
+   TRACE_OK    = 1
+};
+
+class text_trace_reader{
+    public:
+    uint64_t line;          // Line number of the last request read
+    uint64_t timestamp;     // Timestamp column of the last request read, 0 if it had none
+    char error[128];        // Description of the last TRACE_ERROR
+
+    text_trace_reader();
+    ~text_trace_reader();
+
+    bool open(const char *trace_file);
+    void close();
+    trace_status_t next(uint32_t& addr, char& rw);
+
+    private:
+    int fd;
+    trace_compression_t compression;
+    void *gz;               // gzFile when compression == TRACE_GZIP
+    void *zstd;             // ZSTD_DStream when compression == TRACE_ZSTD
+    char *zbuf;             // Compressed input for zstd
+    size_t zpos;
+    size_t zend;
+    bool zframe_open;       // zstd frame started but not finished
+    char *buf;
+    size_t pos;
+    size_t end;
+    bool eof;
+    bool read_failed;       // Read or decompression error ended the input
+
+    long read_bytes(char *dst, size_t n);
+    void refill();
+    void skip_space();
+};
+
+trace_compression_t detect_trace_compression(const char *trace_file);
+
+/*  Pipelined text trace input
+
+    A decode thread runs a text_trace_reader (decompressing if needed) and
+    fills a ring of fixed-size request batches while the simulation thread
+    consumes them, so decompression and parsing overlap with simulation.
+
+       pipelined_trace_reader pipe;
+       pipe.open(trace_file);
+       while ((batch = pipe.next_batch()) != NULL) {
+          ... batch->requests[0 .. batch->count) ...
+          pipe.release_batch();
+       }
+       if (pipe.status == TRACE_ERROR) ... pipe.line, pipe.error
+*/
+#define TRACE_BATCH_SIZE   16384        // Requests per batch
+#define TRACE_RING_SLOTS   8            // Batches in flight between the threads
+
+typedef
+struct {
+   uint32_t count;
+   trace_request_t requests[TRACE_BATCH_SIZE];
+} trace_batch_t;
+
+class pipelined_trace_reader{
+    public:
+    trace_status_t status;  // TRACE_ERROR once the decode thread hit a bad line
+    uint64_t line;
+    char error[128];
+
+    pipelined_trace_reader();
+    ~pipelined_trace_reader();
+
+    bool open(const char *trace_file);
+    const trace_batch_t* next_batch();      // NULL once the trace is exhausted
+    void release_batch();
+
+    private:
+    text_trace_reader reader;
+    std::vector<trace_batch_t> ring;
+    size_t head;            // Next slot the consumer reads
+    size_t tail;            // Next slot the decode thread fills
+    size_t filled;          // Slots ready for the consumer
+    bool done;              // Decode thread has published its last batch
+    bool stop;              // Consumer is shutting down early
+    std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::thread decoder;
+
+    void decode();
+};
+
+// Decode a whole trace file (text or binary) into memory so it can be replayed many times.
+// Returns false (and prints why) if the file could not be opened or is malformed.
+bool load_trace(const char *trace_file, std::vector<trace_request_t>& trace);
+
+/*  Binary trace format
+
+    A 16 byte header followed by blocks of 64 requests. Each block holds the
+    r/w bits of its requests packed into one word (bit i set == request i is
+    a write) followed by the 64 addresses. The last block may be partially
+    filled; the header's count says how many requests are valid.
+
+    ./sim --convert <text_trace> <binary_trace>
+*/
+#define TRACE_BIN_MAGIC    0x42524354   // "TCRB" on disk
+#define TRACE_BIN_VERSION  1
+#define TRACE_BIN_BLOCK    64
+
+typedef
+struct {
+   uint32_t magic;
+   uint32_t version;
+   uint64_t count;      // Number of requests in the file
+} trace_bin_header_t;
+
+typedef
+struct {
+   uint64_t rw_bits;
+   uint32_t addr[TRACE_BIN_BLOCK];
+} trace_bin_block_t;
+
+// Read-only view of a binary trace mapped into memory
+class mapped_trace{
+    public:
+    const trace_bin_block_t *blocks;
+    uint64_t count;
+    const char *error;      // Why open() failed
+
+    mapped_trace() : blocks(nullptr), count(0), error(""), base(nullptr), length(0) {}
+    ~mapped_trace(){ this->close(); }
+
+    bool open(const char *trace_file);
+    void close();
+
+    uint32_t addr(uint64_t i) const { return blocks[i / TRACE_BIN_BLOCK].addr[i % TRACE_BIN_BLOCK]; }
+    char rw(uint64_t i) const { return ((blocks[i / TRACE_BIN_BLOCK].rw_bits >> (i % TRACE_BIN_BLOCK)) & 1) ? 'w' : 'r'; }
+
+    private:
+    void *base;
+    size_t length;
+};
+
+bool is_binary_trace(const char *trace_file);
+bool convert_trace(const char *text_file, const char *bin_file);
+int run_convert(int argc, char *argv[]);
+
+#endif
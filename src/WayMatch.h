@@ -0,0 +1,30 @@
+#ifndef WAYMATCH_H
+#define WAYMATCH_H
+#include <cstdint>
+
+/*  Way-match kernels
+
+    Compare a request tag against up to 64 ways of a set and return two
+    masks; bit w of each refers to way w of the chunk:
+       hit      tag matches and the way is valid
+       invalid  way is not valid
+    The kernels pick no victim: on a miss with no invalid way the
+    replacement policy chooses one (see Replacement.h).
+    The AVX2 or SSE2 kernel is picked at runtime from the CPU's features,
+    with a scalar kernel as the fallback on other machines.
+*/
+typedef
+struct {
+   uint64_t hit;
+   uint64_t invalid;
+} way_masks_t;
+
+typedef way_masks_t (*way_match_fn)(const uint32_t *tags, uint64_t valid, uint32_t num_ways, uint32_t tag);
+
+way_masks_t way_match_scalar(const uint32_t *tags, uint64_t valid, uint32_t num_ways, uint32_t tag);
+
+// Best kernel for this CPU, and its name for reporting
+way_match_fn select_way_match();
+const char* way_match_name(way_match_fn fn);
+
+#endif
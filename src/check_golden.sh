@@ -0,0 +1,44 @@
+#!/bin/bash
+
+# Golden-output check: every ../test/val-proj1/valN.<BLOCKSIZE>_<L1_SIZE>_<L1_ASSOC>_<L2_SIZE>_<L2_ASSOC>_<PREF_N>_<PREF_M>_<trace>.txt
+# holds the expected output of ./sim with those arguments on ../test/traces/<trace>_trace.txt.
+# Outputs are compared ignoring case and whitespace, like the project's "diff -iw".
+
+SIM="$(pwd)/sim"
+GOLDEN_DIR="../test/val-proj1"
+TRACE_DIR="../test/traces"
+MAX_REPORT_LINES=40
+
+if [ ! -x "$SIM" ]; then
+    echo "Error: $SIM not found, run make first"
+    exit 1
+fi
+
+failures=0
+total=0
+for golden in "$GOLDEN_DIR"/val*.txt; do
+    name=$(basename "$golden" .txt)
+    IFS=_ read -r BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M TRACE <<< "${name#*.}"
+    args="$BLOCKSIZE $L1_SIZE $L1_ASSOC $L2_SIZE $L2_ASSOC $PREF_N $PREF_M ${TRACE}_trace.txt"
+    total=$((total+1))
+
+    # Run next to the trace so the trace_file line matches the golden header
+    output=$(cd "$TRACE_DIR" && "$SIM" $args 2>&1)
+    status=$?
+    report=$(diff -iw -u --label "sim $args" --label "$golden" <(echo "$output") "$golden")
+    if [ $status -eq 0 ] && [ -z "$report" ]; then
+        echo "PASS $name"
+        continue
+    fi
+
+    failures=$((failures+1))
+    echo "FAIL $name"
+    echo "   command: (cd $TRACE_DIR && $SIM $args), exit status $status"
+    if [ -n "$report" ]; then
+        echo "   $(echo "$report" | grep -c '^[-+][^-+]') differing lines, first hunks:"
+        echo "$report" | head -n $MAX_REPORT_LINES | sed 's/^/      /'
+    fi
+done
+
+echo "golden outputs: $((total-failures)) of $total passed"
+[ $failures -eq 0 ]
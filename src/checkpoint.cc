@@ -0,0 +1,121 @@
+// Checkpoints: save a hierarchy's state to a file and map it back in
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Cache.h"
+#include "Checkpoint.h"
+#include "Hierarchy.h"
+
+static checkpoint_level_t checkpoint_level(const cache *level, uint32_t num_spans){
+   checkpoint_level_t config;
+   config.BLOCKSIZE  = level->blocksize;
+   config.SIZE       = level->cache_size;
+   config.ASSOC      = level->assoc;
+   config.POLICY     = level->replacement;
+   config.PREFETCHER = level->prefetcher_type;
+   config.PREF_N     = level->prefetch_enabled ? level->prefN : 0;
+   config.PREF_M     = level->prefetch_enabled ? level->prefM : 0;
+   config.num_spans  = num_spans;
+   return config;
+}
+
+bool checkpoint_save(const char *file, cache_hierarchy& hierarchy, uint64_t trace_offset){
+   FILE *fp = fopen(file, "wb");
+   if (fp == (FILE *) NULL) {
+      printf("Error: Unable to open file %s\n", file);
+      return false;
+   }
+
+   checkpoint_header_t header = { CHECKPOINT_MAGIC, CHECKPOINT_VERSION, (uint32_t) hierarchy.levels.size(), 0, trace_offset };
+   bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+   static const char padding[8] = { 0 };
+   std::vector<state_span_t> spans;
+   for (size_t i = 0; ok && i < hierarchy.levels.size(); i++) {
+      spans.clear();
+      hierarchy.levels[i]->state_spans(spans);
+      checkpoint_level_t config = checkpoint_level(hierarchy.levels[i], spans.size());
+      ok = fwrite(&config, sizeof(config), 1, fp) == 1;
+
+      for (size_t s = 0; ok && s < spans.size(); s++) {
+         uint64_t bytes = spans[s].bytes;
+         ok = fwrite(&bytes, sizeof(bytes), 1, fp) == 1 && fwrite(spans[s].data, 1, bytes, fp) == bytes &&
+              fwrite(padding, 1, (8 - bytes % 8) % 8, fp) == (8 - bytes % 8) % 8;
+      }
+   }
+
+   if (fclose(fp) != 0) { ok = false; }
+   if (!ok) { printf("Error: Unable to write checkpoint %s\n", file); }
+   return ok;
+}
+
+bool checkpoint_restore(const char *file, cache_hierarchy& hierarchy, uint64_t& trace_offset){
+   int fd = open(file, O_RDONLY);
+   if (fd < 0) {
+      printf("Error: Unable to open file %s\n", file);
+      return false;
+   }
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(checkpoint_header_t)) {
+      printf("Error: %s is not a checkpoint\n", file);
+      close(fd);
+      return false;
+   }
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      printf("Error: Unable to map checkpoint %s\n", file);
+      return false;
+   }
+
+   const char *pos = (const char *) map;
+   const char *end = pos + st.st_size;
+   const checkpoint_header_t *header = (const checkpoint_header_t *) pos;
+   const char *problem = NULL;
+   if (header->magic != CHECKPOINT_MAGIC || header->version != CHECKPOINT_VERSION) {
+      problem = "not a checkpoint of this version";
+   } else if (header->num_levels != hierarchy.levels.size()) {
+      problem = "saved with a different number of levels";
+   }
+   pos += sizeof(checkpoint_header_t);
+
+   std::vector<state_span_t> spans;
+   for (size_t i = 0; problem == NULL && i < hierarchy.levels.size(); i++) {
+      spans.clear();
+      hierarchy.levels[i]->state_spans(spans);
+      checkpoint_level_t expected = checkpoint_level(hierarchy.levels[i], spans.size());
+      if ((size_t)(end - pos) < sizeof(checkpoint_level_t) || memcmp(pos, &expected, sizeof(expected)) != 0) {
+         problem = "saved with a different configuration";
+         break;
+      }
+      pos += sizeof(checkpoint_level_t);
+
+      for (size_t s = 0; s < spans.size(); s++) {
+         uint64_t bytes;
+         if ((size_t)(end - pos) < sizeof(bytes)) { problem = "truncated"; break; }
+         memcpy(&bytes, pos, sizeof(bytes));
+         pos += sizeof(bytes);
+         uint64_t padded = bytes + (8 - bytes % 8) % 8;
+         if (bytes != spans[s].bytes) { problem = "saved with a different configuration"; break; }
+         if ((uint64_t)(end - pos) < padded) { problem = "truncated"; break; }
+         memcpy(spans[s].data, pos, bytes);
+         pos += padded;
+      }
+   }
+
+   if (problem == NULL) { trace_offset = header->trace_offset; }
+   munmap(map, st.st_size);
+   if (problem != NULL) {
+      printf("Error: checkpoint %s: %s\n", file, problem);
+      return false;
+   }
+   return true;
+}
@@ -0,0 +1,175 @@
+// MSI/MESI coherence between private L1s, by snooping or a sharer directory
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <string>
+
+#include "Cache.h"
+#include "Coherence.h"
+
+static const char *coherence_names[] = { "none", "msi", "mesi" };
+
+bool parse_coherence(const char *name, coherence_t& protocol){
+   for (int i = COHERENCE_NONE; i <= COHERENCE_MESI; i++) {
+      if (strcmp(name, coherence_names[i]) == 0) {
+         protocol = (coherence_t) i;
+         return true;
+      }
+   }
+   return false;
+}
+
+const char *coherence_name(coherence_t protocol){
+   return coherence_names[protocol];
+}
+
+// ------------ Class: coherence_controller ------------ //
+coherence_controller::coherence_controller(coherence_t protocol, bool directory, const std::vector<cache*>& caches){
+   this->protocol = protocol;
+   this->directory = directory;
+   this->caches = caches;
+   coherence_stats_t zero = { 0, 0, 0, 0 };
+   this->stats.assign(caches.size(), zero);
+   for (size_t core = 0; core < caches.size(); core++) {
+      cache *L1 = caches[core];
+      L1->coherence = this;
+      L1->core_id = core;
+      L1->exclusive_bits.assign(L1->valid_bits.size(), 0);
+   }
+}
+
+void coherence_controller::request(uint32_t core, uint32_t addr, char rw){
+   cache *L1 = this->caches[core];
+   uint32_t set, way;
+   bool held = L1->find_block(addr, set, way);
+
+   bool shared = false;
+   if (rw == 'r') {
+      if (!held) { shared = this->read_miss(core, addr); }
+   } else if (!held || !(L1->is_dirty(set, way) || L1->is_exclusive(set, way))) {
+      if (held) { this->stats[core].upgrades++; }
+      this->invalidate_others(core, addr, held);
+   }
+
+   L1->request(addr, rw);
+
+   if (!held) {
+      // Both misses allocate. Read fills are E when no one else has the block (MESI).
+      L1->find_block(addr, set, way);
+      L1->set_exclusive(set, way, rw == 'r' && this->protocol == COHERENCE_MESI && !shared);
+   }
+   if (this->directory) {
+      uint64_t bit = (uint64_t)1 << core;
+      if (rw == 'w') { this->sharers[this->block_number(addr)] = bit; }
+      else if (!held) { this->sharers[this->block_number(addr)] |= bit; }
+   }
+}
+
+void coherence_controller::on_evict(uint32_t core, uint32_t addr){
+   if (!this->directory) { return; }
+   std::unordered_map<uint32_t, uint64_t>::iterator entry = this->sharers.find(this->block_number(addr));
+   if (entry == this->sharers.end()) { return; }
+   entry->second &= ~((uint64_t)1 << core);
+   if (entry->second == 0) { this->sharers.erase(entry); }
+}
+
+// Cores other than core that must be checked: all of them when snooping, the listed sharers with a directory
+void coherence_controller::remote_caches(uint32_t core, uint32_t addr, std::vector<uint32_t>& remote){
+   remote.clear();
+   if (!this->directory) {
+      for (uint32_t other = 0; other < this->caches.size(); other++) {
+         if (other != core) { remote.push_back(other); }
+      }
+      return;
+   }
+   std::unordered_map<uint32_t, uint64_t>::const_iterator entry = this->sharers.find(this->block_number(addr));
+   if (entry == this->sharers.end()) { return; }
+   uint64_t mask = entry->second & ~((uint64_t)1 << core);
+   while (mask != 0) {
+      remote.push_back(__builtin_ctzll(mask));
+      mask &= mask - 1;
+   }
+}
+
+// Downgrade every other copy to S; true if any copy exists
+bool coherence_controller::read_miss(uint32_t core, uint32_t addr){
+   bool shared = false;
+   this->remote_caches(core, addr, this->remote);
+   for (size_t i = 0; i < this->remote.size(); i++) {
+      cache *other = this->caches[this->remote[i]];
+      uint32_t set, way;
+      this->stats[core].probes++;
+      if (!other->find_block(addr, set, way)) { continue; }
+      shared = true;
+      if (other->is_dirty(set, way)) {
+         // M -> S: the owner supplies the block and writes it back
+         this->stats[core].interventions++;
+         other->writeback_logic(set, way);
+         other->set_dirty(set, way, false);
+      } else if (other->is_exclusive(set, way)) {
+         this->stats[core].interventions++;
+      }
+      other->set_exclusive(set, way, false);
+   }
+   return shared;
+}
+
+// Remove every other copy before core writes. An M copy moves to the writer, so it is not written back.
+void coherence_controller::invalidate_others(uint32_t core, uint32_t addr, bool held){
+   this->remote_caches(core, addr, this->remote);
+   for (size_t i = 0; i < this->remote.size(); i++) {
+      cache *other = this->caches[this->remote[i]];
+      uint32_t set, way;
+      this->stats[core].probes++;
+      if (!other->find_block(addr, set, way)) { continue; }
+      if (!held && (other->is_dirty(set, way) || other->is_exclusive(set, way))) { this->stats[core].interventions++; }
+      other->invalidate_block(set, way, false);
+      this->stats[core].invalidations++;
+   }
+}
+
+// A total, then one line per core
+static void print_per_core(const char *label, const std::vector<uint64_t>& values){
+   uint64_t total = 0;
+   for (size_t core = 0; core < values.size(); core++) { total += values[core]; }
+   printf("%-25s%" PRIu64 "\n", label, total);
+   for (size_t core = 0; core < values.size(); core++) {
+      char core_label[32];
+      snprintf(core_label, sizeof(core_label), "core%u:", (unsigned) core);
+      printf("   %-22s%" PRIu64 "\n", core_label, values[core]);
+   }
+}
+
+void coherence_controller::print_measurements(){
+   size_t num_cores = this->stats.size();
+   std::vector<uint64_t> upgrades(num_cores), interventions(num_cores), invalidations(num_cores), probes(num_cores);
+   for (size_t core = 0; core < num_cores; core++) {
+      upgrades[core] = this->stats[core].upgrades;
+      interventions[core] = this->stats[core].interventions;
+      invalidations[core] = this->stats[core].invalidations;
+      probes[core] = this->stats[core].probes;
+   }
+
+   printf("===== Coherence (%s, %s) =====\n", coherence_name(this->protocol), this->directory ? "directory" : "snooping");
+   print_per_core("upgrade misses:", upgrades);
+   print_per_core("interventions:", interventions);
+   print_per_core("invalidations:", invalidations);
+   print_per_core("probes:", probes);
+   printf("\n");
+}
+
+void coherence_controller::register_stats(stats_registry& registry) const {
+   registry.group = "coherence";
+   for (size_t core = 0; core < this->stats.size(); core++) {
+      const coherence_stats_t& counters = this->stats[core];
+      std::string suffix = "_core" + std::to_string(core);
+      std::string label = "core" + std::to_string(core) + " ";
+      registry.counter("upgrades" + suffix, label + "upgrade misses:", counters.upgrades);
+      registry.counter("interventions" + suffix, label + "interventions:", counters.interventions);
+      registry.counter("invalidations" + suffix, label + "invalidations:", counters.invalidations);
+      registry.counter("probes" + suffix, label + "probes:", counters.probes);
+   }
+}
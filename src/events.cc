@@ -0,0 +1,65 @@
+// Event tracing: per-thread record buffers written to one binary file
+
+#include <stdio.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "Events.h"
+
+static FILE *event_file = NULL;
+static std::mutex event_lock;                   // Guards event_file
+static std::atomic<bool> event_tracing(false);
+static std::atomic<uint32_t> event_threads(0);
+
+class event_buffer{
+    public:
+    std::vector<event_record_t> records;
+    uint16_t thread;
+
+    event_buffer() : thread((uint16_t) event_threads++) { records.reserve(EVENT_BUFFER_SIZE); }
+    ~event_buffer() { flush(); }
+
+    void flush(){
+        if (records.empty()) { return; }
+        std::lock_guard<std::mutex> guard(event_lock);
+        if (event_file != NULL) {
+            fwrite(&records[0], sizeof(event_record_t), records.size(), event_file);
+        }
+        records.clear();
+    }
+};
+
+static thread_local event_buffer thread_events;
+
+bool event_trace_open(const char *file){
+   std::lock_guard<std::mutex> guard(event_lock);
+   event_file = fopen(file, "wb");
+   if (event_file == (FILE *) NULL) {
+      return false;
+   }
+   event_file_header_t header = { EVENT_MAGIC, EVENT_VERSION, (uint32_t) sizeof(event_record_t), 0 };
+   fwrite(&header, sizeof(header), 1, event_file);
+   event_tracing = true;
+   return true;
+}
+
+// Worker threads flush when they exit; the calling thread flushes here
+void event_trace_close(){
+   if (!event_tracing) { return; }
+   thread_events.flush();
+   std::lock_guard<std::mutex> guard(event_lock);
+   event_tracing = false;
+   fclose(event_file);
+   event_file = NULL;
+}
+
+void event_record(event_type_t type, uint32_t level, uint32_t set, uint32_t way, uint32_t addr){
+   if (!event_tracing.load(std::memory_order_relaxed)) { return; }
+   event_buffer& buffer = thread_events;
+   event_record_t record = { addr, set, way, (uint8_t) type, (uint8_t) level, buffer.thread };
+   buffer.records.push_back(record);
+   if (buffer.records.size() == EVENT_BUFFER_SIZE) {
+      buffer.flush();
+   }
+}
@@ -6,18 +6,17 @@ TRACE_FILE="../test/traces/gcc_trace.txt"
 
 # Output files
 OUTPUT_CSV="experiment_results.csv"
-
-# Write header to CSV file
-echo "log2(L1_SIZE),L1_SIZE (Bytes),Associativity,L1_miss_rate" > $OUTPUT_CSV
+GRID_FILE="experiment_grid.txt"
+SWEEP_CSV="experiment_sweep.csv"
 
 # Associativities to test
 declare -a associativities=("1" "2" "4" "8" "FULLY")
 
-# Loop over cache sizes (from 1KB to 1MB in powers of two)
+# Build the sweep grid over cache sizes (from 1KB to 1MB in powers of two)
+echo "# BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M" > $GRID_FILE
 for ((exp=10; exp<=20; exp++))
 do
     L1_SIZE=$((2**exp))  # L1_SIZE in bytes
-    LOG2_L1_SIZE=$exp
 
     for ASSOC in "${associativities[@]}"
     do
@@ -27,22 +26,19 @@ do
         else
             L1_ASSOC=$ASSOC
         fi
+        echo "$BLOCKSIZE $L1_SIZE $L1_ASSOC 0 0 0 0" >> $GRID_FILE
+    done
+done
 
-        # Run the simulator
-        OUTPUT=$(./sim $BLOCKSIZE $L1_SIZE $L1_ASSOC 0 0 0 0 $TRACE_FILE)
-
-        # Parse the output to get L1 miss rate
-        MISS_RATE_LINE=$(echo "$OUTPUT" | grep "^e\. L1 miss rate")
-        MISS_RATE=$(echo "$MISS_RATE_LINE" | awk '{print $5}')
-
-        # Write to CSV
-        echo "$LOG2_L1_SIZE,$L1_SIZE,$ASSOC,$MISS_RATE" >> $OUTPUT_CSV
-
-        # Write to TXT
-        echo "log2(L1_SIZE): $LOG2_L1_SIZE, L1_SIZE: $L1_SIZE Bytes, Associativity: $ASSOC, L1 miss rate: $MISS_RATE" >> $OUTPUT_TXT
+# Run every configuration against a single decode of the trace
+./sim --sweep --threads 0 $GRID_FILE $TRACE_FILE $SWEEP_CSV || exit 1
 
-        # Optional: Print progress to console
-        echo "Completed: L1_SIZE=$L1_SIZE Bytes, Associativity=$ASSOC, L1 miss rate=$MISS_RATE"
+# Write header to CSV file
+echo "log2(L1_SIZE),L1_SIZE (Bytes),Associativity,L1_miss_rate" > $OUTPUT_CSV
 
-    done
-done
\ No newline at end of file
+# Convert sweep rows (BLOCKSIZE,L1_SIZE,L1_ASSOC,...,L1_miss_rate in column 12)
+awk -F, -v bs=$BLOCKSIZE 'NR > 1 {
+    assoc = ($3 == $2 / bs) ? "FULLY" : $3
+    printf "%d,%d,%s,%s\n", log($2) / log(2) + 0.5, $2, assoc, $12
+    printf "Completed: L1_SIZE=%d Bytes, Associativity=%s, L1 miss rate=%s\n", $2, assoc, $12 > "/dev/stderr"
+}' $SWEEP_CSV >> $OUTPUT_CSV
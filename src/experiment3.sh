@@ -6,58 +6,36 @@ TRACE_FILE="../test/traces/gcc_trace.txt"
 # Output files
 OUTPUT_CSV="experiment_graph4_results.csv"
 OUTPUT_TXT="experiment_graph4_results.txt"
+GRID_FILE="experiment_graph4_grid.txt"
+SWEEP_CSV="experiment_graph4_sweep.csv"
 
 # Associativity
 ASSOC=4
 
 # Block sizes to test (BLOCKSIZE = 16, 32, 64, 128)
-declare -a block_sizes=("16" "32" "64" "128")
+block_sizes="16,32,64,128"
 
 # Cache sizes to test (SIZE = 1KB, 2KB, 4KB, 8KB, 16KB, 32KB)
 declare -a cache_sizes=("1024" "2048" "4096" "8192" "16384" "32768")
 
-# Write header to CSV file
-echo "log2(BLOCKSIZE),BLOCKSIZE (Bytes),L1_SIZE (Bytes),L1_miss_rate" > $OUTPUT_CSV
-
-# Loop over cache sizes
+# Build the sweep grid, cache size outermost to keep the original row order
+echo "# BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M" > $GRID_FILE
 for L1_SIZE in "${cache_sizes[@]}"
 do
-    # Loop over block sizes
-    for BLOCKSIZE in "${block_sizes[@]}"
-    do
-        # Compute log2(BLOCKSIZE)
-        case $BLOCKSIZE in
-            16)
-                LOG2_BLOCKSIZE=4
-                ;;
-            32)
-                LOG2_BLOCKSIZE=5
-                ;;
-            64)
-                LOG2_BLOCKSIZE=6
-                ;;
-            128)
-                LOG2_BLOCKSIZE=7
-                ;;
-            *)
-                LOG2_BLOCKSIZE=0
-                ;;
-        esac
-
-        # Run the simulator
-        OUTPUT=$(./sim $BLOCKSIZE $L1_SIZE $ASSOC 0 0 0 0 $TRACE_FILE)
-
-        # Parse the output to get L1 miss rate
-        MISS_RATE_LINE=$(echo "$OUTPUT" | grep "^e\. L1 miss rate")
-        MISS_RATE=$(echo "$MISS_RATE_LINE" | awk '{print $5}')
-
-        # Write to CSV
-        echo "$LOG2_BLOCKSIZE,$BLOCKSIZE,$L1_SIZE,$MISS_RATE" >> $OUTPUT_CSV
-
-        # Write to TXT
-        echo "log2(BLOCKSIZE): $LOG2_BLOCKSIZE, BLOCKSIZE: $BLOCKSIZE Bytes, L1_SIZE: $L1_SIZE Bytes, L1 miss rate: $MISS_RATE" >> $OUTPUT_TXT
-
-        # Optional: Print progress to console
-        echo "Completed: BLOCKSIZE=$BLOCKSIZE Bytes, L1_SIZE=$L1_SIZE Bytes, L1 miss rate=$MISS_RATE"
-    done
-done
\ No newline at end of file
+    echo "$block_sizes $L1_SIZE $ASSOC 0 0 0 0" >> $GRID_FILE
+done
+
+# Run every configuration against a single decode of the trace
+./sim --sweep --threads 0 $GRID_FILE $TRACE_FILE $SWEEP_CSV || exit 1
+
+# Write header to CSV file
+echo "log2(BLOCKSIZE),BLOCKSIZE (Bytes),L1_SIZE (Bytes),L1_miss_rate" > $OUTPUT_CSV
+: > $OUTPUT_TXT
+
+# Convert sweep rows (BLOCKSIZE in column 1, L1_miss_rate in column 12)
+awk -F, 'NR > 1 {
+    log2_bs = log($1) / log(2) + 0.5
+    printf "%d,%d,%d,%s\n", log2_bs, $1, $2, $12 >> "'$OUTPUT_CSV'"
+    printf "log2(BLOCKSIZE): %d, BLOCKSIZE: %d Bytes, L1_SIZE: %d Bytes, L1 miss rate: %s\n", log2_bs, $1, $2, $12 >> "'$OUTPUT_TXT'"
+    printf "Completed: BLOCKSIZE=%d Bytes, L1_SIZE=%d Bytes, L1 miss rate=%s\n", $1, $2, $12
+}' $SWEEP_CSV
@@ -11,27 +11,24 @@ TRACE_FILE="../test/streams_trace.txt"
 
 # Output files
 OUTPUT_CSV="experiment5results.csv"
+GRID_FILE="experiment5grid.txt"
+SWEEP_CSV="experiment5sweep.csv"
 
 # PREF_N values to test (0 to 4)
-declare -a PREF_N_values=("0" "1" "2" "3" "4")
+PREF_N_values="0,1,2,3,4"
 
-# Write header to CSV file
-echo "PREF_N,L1_miss_rate" > $OUTPUT_CSV
-
-# Loop over PREF_N values
-for PREF_N in "${PREF_N_values[@]}"
-do
-    # Run the simulator
-    OUTPUT=$(./sim $BLOCKSIZE $L1_SIZE $L1_ASSOC $L2_SIZE $L2_ASSOC $PREF_N $PREF_M $TRACE_FILE)
+# One grid line expands to every PREF_N value
+echo "# BLOCKSIZE L1_SIZE L1_ASSOC L2_SIZE L2_ASSOC PREF_N PREF_M" > $GRID_FILE
+echo "$BLOCKSIZE $L1_SIZE $L1_ASSOC $L2_SIZE $L2_ASSOC $PREF_N_values $PREF_M" >> $GRID_FILE
 
-    # Parse the output to get the L1 miss rate
-    L1_MISS_RATE_LINE=$(echo "$OUTPUT" | grep "^e\. L1 miss rate:")
-    L1_MISS_RATE=$(echo "$L1_MISS_RATE_LINE" | awk '{print $5}')
+# Run every configuration against a single decode of the trace
+./sim --sweep --threads 0 $GRID_FILE $TRACE_FILE $SWEEP_CSV || exit 1
 
-    # Write to CSV
-    echo "$PREF_N,$L1_MISS_RATE" >> $OUTPUT_CSV
-
-    # Optional: Print progress to console
-    echo "Completed: PREF_N=$PREF_N, L1 miss rate=$L1_MISS_RATE"
+# Write header to CSV file
+echo "PREF_N,L1_miss_rate" > $OUTPUT_CSV
 
-done
\ No newline at end of file
+# Convert sweep rows (PREF_N in column 6, L1_miss_rate in column 12)
+awk -F, 'NR > 1 {
+    printf "%d,%s\n", $6, $12
+    printf "Completed: PREF_N=%d, L1 miss rate=%s\n", $6, $12 > "/dev/stderr"
+}' $SWEEP_CSV >> $OUTPUT_CSV
@@ -0,0 +1,250 @@
+// Cache hierarchies: the classic L1/L2 wiring and arbitrary-depth configurations
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <algorithm>
+#include <string>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+
+// ------------ Class: cache_hierarchy ------------ //
+cache_hierarchy::cache_hierarchy(const cache_params_t& params){
+   std::vector<level_params_t> level_params;
+   classic_levels(params, level_params);
+   this->build(level_params);
+}
+
+cache_hierarchy::cache_hierarchy(const std::vector<level_params_t>& level_params){
+   this->build(level_params);
+}
+
+// Build from the bottom up so each level can be linked to the one below it
+void cache_hierarchy::build(const std::vector<level_params_t>& level_params){
+   this->levels.assign(level_params.size(), NULL);
+   cache *below = NULL;
+   for (size_t i = level_params.size(); i-- > 0; ) {
+      const level_params_t& p = level_params[i];
+      this->levels[i] = new cache(p.BLOCKSIZE, p.SIZE, p.ASSOC, p.PREF_N, p.PREF_M, below, p.NAME,
+                                  (replacement_t) p.POLICY, (prefetcher_t) p.PREFETCHER);
+      this->levels[i]->level = i + 1;
+      below = this->levels[i];
+   }
+   this->L1 = this->levels[0];
+   this->L2 = (this->levels.size() > 1) ? this->levels[1] : NULL;
+}
+
+cache_hierarchy::~cache_hierarchy(){
+   for (size_t i = 0; i < this->levels.size(); i++) {
+      delete this->levels[i];
+   }
+}
+
+void cache_hierarchy::request_batch(const trace_request_t *requests, size_t count){
+#ifdef TRACE_EVENTS
+   for (size_t i = 0; i < count; i++) { this->L1->request(requests[i].addr, requests[i].rw); }
+#else
+   for (size_t done = 0; done < count; done += HIERARCHY_BATCH_SIZE) {
+      this->L1->request_batch(requests + done, std::min<size_t>(count - done, HIERARCHY_BATCH_SIZE));
+   }
+#endif
+}
+
+void cache_hierarchy::print_contents(){
+   for (size_t i = 0; i < this->levels.size(); i++) {
+      this->levels[i]->print_cache_stats();
+   }
+   for (size_t i = 0; i < this->levels.size(); i++) {
+      cache *level = this->levels[i];
+      if (level->prefetch_enabled && level->prefetch_engine == NULL) { level->printStreamBuffer(); }
+   }
+}
+
+void cache_hierarchy::print_measurements(){
+   for (size_t i = 0; i < this->levels.size(); i++) {
+      print_level_measurements(this->levels[i]);
+   }
+   printf("===== Memory =====\n");
+   printf("memory traffic:          %" PRIu64 "\n", this->levels.back()->memory_traffic);
+}
+
+void register_memory_stats(stats_registry& registry, const cache *last_level){
+   registry.group = "memory";
+   registry.counter("memory_traffic", "memory traffic:", last_level->memory_traffic);
+}
+
+// Same measurements as a - q for one level, from its stats registry
+void print_level_measurements(const cache *c){
+   printf("===== %s measurements =====\n", c->cache_name.c_str());
+   c->stats.print_text();
+   printf("\n");
+}
+
+// One line per level: NAME: BLOCKSIZE SIZE ASSOC POLICY [PREFETCHER PREF_N PREF_M]
+void print_level_config(const std::vector<level_params_t>& levels){
+   for (size_t i = 0; i < levels.size(); i++) {
+      const level_params_t& level = levels[i];
+      printf("%-12s%u %u %u %s", (level.NAME + ":").c_str(), level.BLOCKSIZE, level.SIZE, level.ASSOC,
+         replacement_name((replacement_t) level.POLICY));
+      if (level.PREF_N != 0 && level.PREF_M != 0) {
+         printf(" %s %u %u", prefetcher_name((prefetcher_t) level.PREFETCHER), level.PREF_N, level.PREF_M);
+      }
+      printf("\n");
+   }
+}
+
+// L2 only if L2_SIZE != 0; the prefetcher goes on L2 if there is one, else on L1
+void classic_levels(const cache_params_t& params, std::vector<level_params_t>& levels){
+   level_params_t L1;
+   L1.NAME       = "L1";
+   L1.BLOCKSIZE  = params.BLOCKSIZE;
+   L1.SIZE       = params.L1_SIZE;
+   L1.ASSOC      = params.L1_ASSOC;
+   L1.POLICY     = params.L1_POLICY;
+   L1.PREFETCHER = params.PREFETCHER;
+   L1.PREF_N     = (params.L2_SIZE == 0) ? params.PREF_N : 0;
+   L1.PREF_M     = (params.L2_SIZE == 0) ? params.PREF_M : 0;
+
+   levels.clear();
+   levels.push_back(L1);
+   if (params.L2_SIZE != 0) {
+      level_params_t L2 = L1;
+      L2.NAME   = "L2";
+      L2.SIZE   = params.L2_SIZE;
+      L2.ASSOC  = params.L2_ASSOC;
+      L2.POLICY = params.L2_POLICY;
+      L2.PREF_N = params.PREF_N;
+      L2.PREF_M = params.PREF_M;
+      levels.push_back(L2);
+   }
+}
+
+static bool parse_level_number(const char *field, uint32_t& value){
+   char *end;
+   unsigned long parsed = strtoul(field, &end, 10);
+   if (end == field || *end != '\0') { return false; }
+   value = (uint32_t) parsed;
+   return true;
+}
+
+bool parse_level_spec(char *spec, const char *separators, level_params_t& level){
+   std::vector<char *> fields;
+   char *save;
+   for (char *tok = strtok_r(spec, separators, &save); tok != NULL; tok = strtok_r(NULL, separators, &save)) {
+      fields.push_back(tok);
+   }
+   if (fields.size() != 4 && fields.size() != 5 && fields.size() != 8) {
+      printf("Error: a level is NAME BLOCKSIZE SIZE ASSOC [POLICY [PREFETCHER PREF_N PREF_M]], found %d fields\n", (int) fields.size());
+      return false;
+   }
+
+   level.NAME = fields[0];
+   level.POLICY = REPL_LRU;
+   level.PREFETCHER = PREF_STREAM;
+   level.PREF_N = 0;
+   level.PREF_M = 0;
+   if (!parse_level_number(fields[1], level.BLOCKSIZE) || !parse_level_number(fields[2], level.SIZE) ||
+       !parse_level_number(fields[3], level.ASSOC)) {
+      printf("Error: level %s: BLOCKSIZE, SIZE and ASSOC must be numbers\n", fields[0]);
+      return false;
+   }
+
+   replacement_t policy;
+   if (fields.size() >= 5) {
+      if (!parse_replacement(fields[4], policy)) {
+         printf("Error: level %s: unknown replacement policy %s\n", fields[0], fields[4]);
+         return false;
+      }
+      level.POLICY = policy;
+   }
+
+   prefetcher_t prefetcher;
+   if (fields.size() == 8) {
+      if (!parse_prefetcher(fields[5], prefetcher)) {
+         printf("Error: level %s: unknown prefetcher %s\n", fields[0], fields[5]);
+         return false;
+      }
+      if (!parse_level_number(fields[6], level.PREF_N) || !parse_level_number(fields[7], level.PREF_M)) {
+         printf("Error: level %s: PREF_N and PREF_M must be numbers\n", fields[0]);
+         return false;
+      }
+      level.PREFETCHER = prefetcher;
+   }
+   return true;
+}
+
+bool parse_hierarchy_file(const char *file, std::vector<level_params_t>& levels){
+   FILE *fp = fopen(file, "r");
+   if (fp == (FILE *) NULL) {
+      printf("Error: Unable to open file %s\n", file);
+      return false;
+   }
+
+   char line[1024];
+   int line_number = 0;
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      line_number++;
+
+      // Strip comments and skip blank lines
+      char *comment = strchr(line, '#');
+      if (comment != NULL) { *comment = '\0'; }
+      if (strspn(line, " \t\r\n") == strlen(line)) { continue; }
+
+      level_params_t level;
+      if (!parse_level_spec(line, " \t\r\n", level)) {
+         printf("Error: %s:%d: malformed level\n", file, line_number);
+         fclose(fp);
+         return false;
+      }
+      levels.push_back(level);
+   }
+   fclose(fp);
+   return true;
+}
+
+// Check that a level divides into a power-of-two number of sets
+static bool valid_level(uint32_t blocksize, uint32_t size, uint32_t assoc){
+   if (assoc == 0 || size % (blocksize * assoc) != 0) { return false; }
+   uint32_t num_sets = size / (blocksize * assoc);
+   return num_sets != 0 && (num_sets & (num_sets - 1)) == 0;
+}
+
+bool valid_hierarchy(const std::vector<level_params_t>& levels){
+   if (levels.empty()) {
+      printf("Error: the hierarchy has no levels\n");
+      return false;
+   }
+   for (size_t i = 0; i < levels.size(); i++) {
+      const level_params_t& level = levels[i];
+      const char *name = level.NAME.c_str();
+      if (level.BLOCKSIZE == 0 || (level.BLOCKSIZE & (level.BLOCKSIZE - 1)) != 0) {
+         printf("Error: level %s: BLOCKSIZE must be a power of two\n", name);
+         return false;
+      }
+      if (!valid_level(level.BLOCKSIZE, level.SIZE, level.ASSOC)) {
+         printf("Error: level %s: SIZE / (BLOCKSIZE * ASSOC) must be a power of two\n", name);
+         return false;
+      }
+      if (!replacement_supports((replacement_t) level.POLICY, level.ASSOC)) {
+         printf("Error: level %s: plru replacement needs a power-of-two associativity\n", name);
+         return false;
+      }
+      if (i > 0 && level.BLOCKSIZE < levels[i - 1].BLOCKSIZE) {
+         printf("Error: level %s: BLOCKSIZE is smaller than the level above\n", name);
+         return false;
+      }
+   }
+   return true;
+}
+
+bool valid_cache_params(const cache_params_t& params){
+   if (params.BLOCKSIZE == 0 || (params.BLOCKSIZE & (params.BLOCKSIZE - 1)) != 0) { return false; }
+   if (!valid_level(params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC)) { return false; }
+   if (params.L2_SIZE != 0 && !valid_level(params.BLOCKSIZE, params.L2_SIZE, params.L2_ASSOC)) { return false; }
+   if (!replacement_supports((replacement_t) params.L1_POLICY, params.L1_ASSOC)) { return false; }
+   if (params.L2_SIZE != 0 && !replacement_supports((replacement_t) params.L2_POLICY, params.L2_ASSOC)) { return false; }
+   return true;
+}
@@ -0,0 +1,231 @@
+// Multi-core mode: private L1 per core in front of shared lower levels
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <string>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Coherence.h"
+#include "Multicore.h"
+#include "Trace.h"
+
+// ------------ Class: multicore_system ------------ //
+multicore_system::multicore_system(const std::vector<level_params_t>& levels, uint32_t num_cores, coherence_t protocol, bool directory){
+   std::vector<level_params_t> shared_levels(levels.begin() + 1, levels.end());
+   this->shared = new cache_hierarchy(shared_levels);
+   for (size_t i = 0; i < this->shared->levels.size(); i++) {
+      this->shared->levels[i]->level = i + 2;
+      this->shared->levels[i]->track_owners(num_cores);
+   }
+
+   const level_params_t& p = levels[0];
+   for (uint32_t core = 0; core < num_cores; core++) {
+      char name[64];
+      snprintf(name, sizeof(name), "core%u %s", core, p.NAME.c_str());
+      cache *L1 = new cache(p.BLOCKSIZE, p.SIZE, p.ASSOC, p.PREF_N, p.PREF_M, this->shared->L1, name,
+                            (replacement_t) p.POLICY, (prefetcher_t) p.PREFETCHER);
+      L1->level = 1;
+      this->cores.push_back(L1);
+   }
+
+   this->coherence = NULL;
+   if (protocol != COHERENCE_NONE) { this->coherence = new coherence_controller(protocol, directory, this->cores); }
+}
+
+multicore_system::~multicore_system(){
+   delete this->coherence;
+   for (size_t i = 0; i < this->cores.size(); i++) {
+      delete this->cores[i];
+   }
+   delete this->shared;
+}
+
+// Shared levels charge fills (and the evictions they cause) to the requesting core
+void multicore_system::request(uint32_t core, uint32_t addr, char rw){
+   for (size_t i = 0; i < this->shared->levels.size(); i++) {
+      this->shared->levels[i]->requester = core;
+   }
+   if (this->coherence != NULL) { this->coherence->request(core, addr, rw); }
+   else { this->cores[core]->request(addr, rw); }
+}
+
+void multicore_system::print_contents(){
+   for (size_t i = 0; i < this->cores.size(); i++) {
+      this->cores[i]->print_cache_stats();
+   }
+   for (size_t i = 0; i < this->cores.size(); i++) {
+      cache *L1 = this->cores[i];
+      if (L1->prefetch_enabled && L1->prefetch_engine == NULL) { L1->printStreamBuffer(); }
+   }
+   this->shared->print_contents();
+}
+
+void multicore_system::print_measurements(){
+   for (size_t i = 0; i < this->cores.size(); i++) {
+      print_level_measurements(this->cores[i]);
+   }
+   for (size_t i = 0; i < this->shared->levels.size(); i++) {
+      print_level_measurements(this->shared->levels[i]);
+   }
+   if (this->coherence != NULL) { this->coherence->print_measurements(); }
+   printf("===== Memory =====\n");
+   printf("memory traffic:          %" PRIu64 "\n", this->shared->levels.back()->memory_traffic);
+}
+
+// One core's trace: text (with an optional timestamp column) or memory-mapped binary
+class core_trace{
+    public:
+    const char *file;
+    bool binary;
+    text_trace_reader text;
+    mapped_trace bin;
+    uint64_t next_index;        // Binary traces only
+
+    // The request the core issues next
+    bool live;
+    uint32_t addr;
+    char rw;
+    uint64_t timestamp;
+
+    core_trace() : file(NULL), binary(false), next_index(0), live(false), addr(0), rw('r'), timestamp(0) {}
+
+    bool open(const char *trace_file){
+       this->file = trace_file;
+       this->binary = is_binary_trace(trace_file);
+       return this->binary ? this->bin.open(trace_file) : this->text.open(trace_file);
+    }
+
+    // Load the next request; exits on a malformed trace
+    void advance(){
+       if (this->binary) {
+          this->live = this->next_index < this->bin.count;
+          if (this->live) {
+             this->addr = this->bin.addr(this->next_index);
+             this->rw = this->bin.rw(this->next_index);
+             this->next_index++;
+          }
+          return;
+       }
+       trace_status_t status = this->text.next(this->addr, this->rw);
+       if (status == TRACE_ERROR) {
+          printf("Error: %s:%" PRIu64 ": %s\n", this->file, this->text.line, this->text.error);
+          exit(EXIT_FAILURE);
+       }
+       this->live = (status == TRACE_OK);
+       this->timestamp = this->text.timestamp;
+    }
+};
+
+bool parse_interleave(const char *name, interleave_t& interleave){
+   if (strcmp(name, "rr") == 0) { interleave = INTERLEAVE_RR; return true; }
+   if (strcmp(name, "time") == 0) { interleave = INTERLEAVE_TIME; return true; }
+   return false;
+}
+
+int run_multicore(const std::vector<level_params_t>& levels, const std::vector<const char *>& trace_files, interleave_t interleave,
+                  coherence_t protocol, bool directory, const output_params_t& output){
+   if (levels.size() < 2) {
+      printf("Error: --cores needs a shared level below L1 (L2_SIZE != 0 or a second --level).\n");
+      exit(EXIT_FAILURE);
+   }
+   if (trace_files.size() > 0xFFFF) {
+      printf("Error: at most 65535 cores are supported.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (directory && protocol == COHERENCE_NONE) {
+      printf("Error: --directory needs --coherence msi or mesi.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (directory && trace_files.size() > DIRECTORY_MAX_CORES) {
+      printf("Error: --directory supports at most %d cores.\n", DIRECTORY_MAX_CORES);
+      exit(EXIT_FAILURE);
+   }
+   if (protocol != COHERENCE_NONE && levels[0].PREF_N != 0 && levels[0].PREF_M != 0) {
+      printf("Error: --coherence does not model prefetching into the private %s.\n", levels[0].NAME.c_str());
+      exit(EXIT_FAILURE);
+   }
+
+   uint32_t num_cores = trace_files.size();
+   std::vector<core_trace> traces(num_cores);
+   for (uint32_t core = 0; core < num_cores; core++) {
+      if (!traces[core].open(trace_files[core])) {
+         if (traces[core].binary) { printf("Error: Unable to map binary trace %s: %s\n", trace_files[core], traces[core].bin.error); }
+         else { printf("Error: Unable to open file %s\n", trace_files[core]); }
+         exit(EXIT_FAILURE);
+      }
+      if (traces[core].binary && interleave == INTERLEAVE_TIME) {
+         printf("Error: binary trace %s has no timestamps for --interleave time\n", trace_files[core]);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   // Print simulator configuration.
+   if (output.FORMAT == FORMAT_TEXT) {
+      printf("===== Simulator configuration =====\n");
+      print_level_config(levels);
+      printf("cores:      %u, private %s\n", num_cores, levels[0].NAME.c_str());
+      printf("interleave: %s\n", interleave == INTERLEAVE_RR ? "rr" : "time");
+      if (protocol != COHERENCE_NONE) {
+         printf("coherence:  %s, %s\n", coherence_name(protocol), directory ? "directory" : "snooping");
+      }
+      for (uint32_t core = 0; core < num_cores; core++) {
+         char label[32];
+         snprintf(label, sizeof(label), "core%u:", core);
+         printf("%-12s%s\n", label, trace_files[core]);
+      }
+      printf("\n");
+   }
+
+   multicore_system system(levels, num_cores, protocol, directory);
+   for (uint32_t core = 0; core < num_cores; core++) {
+      traces[core].advance();
+   }
+
+   if (interleave == INTERLEAVE_RR) {
+      bool any_live = true;
+      while (any_live) {
+         any_live = false;
+         for (uint32_t core = 0; core < num_cores; core++) {
+            core_trace& t = traces[core];
+            if (!t.live) { continue; }
+            system.request(core, t.addr, t.rw);
+            t.advance();
+            any_live = true;
+         }
+      }
+   } else {
+      while (true) {
+         int next = -1;
+         for (uint32_t core = 0; core < num_cores; core++) {
+            if (traces[core].live && (next < 0 || traces[core].timestamp < traces[next].timestamp)) { next = core; }
+         }
+         if (next < 0) { break; }
+         system.request(next, traces[next].addr, traces[next].rw);
+         traces[next].advance();
+      }
+   }
+
+   event_trace_close();
+   if (output.FORMAT == FORMAT_TEXT) {
+      if (output.CONTENTS) { system.print_contents(); }
+      system.print_measurements();
+      return(0);
+   }
+
+   std::vector<cache*> caches(system.cores);
+   caches.insert(caches.end(), system.shared->levels.begin(), system.shared->levels.end());
+   stats_registry coherence, memory;
+   std::vector<const stats_registry*> groups;
+   if (system.coherence != NULL) {
+      system.coherence->register_stats(coherence);
+      groups.push_back(&coherence);
+   }
+   register_memory_stats(memory, system.shared->levels.back());
+   groups.push_back(&memory);
+   write_stats(stdout, output.FORMAT, trace_files, caches, groups, output.CONTENTS);
+   return(0);
+}
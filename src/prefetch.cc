@@ -0,0 +1,125 @@
+// Prefetch engines that fill the cache directly: next-N-line, delta and markov
+
+#include <string.h>
+#include <vector>
+
+#include "Prefetch.h"
+
+// ------------ Class: nextline_prefetcher ------------ //
+void nextline_prefetcher::train(uint32_t block, std::vector<uint32_t>& candidates){
+   for (uint32_t i = 1; i <= this->degree; i++) {
+      candidates.push_back(block + i);
+   }
+}
+
+// ------------ Class: delta_prefetcher ------------ //
+delta_prefetcher::delta_prefetcher(uint32_t table_size, uint32_t degree) : prefetcher(table_size, degree) {
+   delta_entry_t empty = { 0, 0, 0, false, false, 0 };
+   this->table.assign(table_size, empty);
+   this->accesses = 0;
+}
+
+void delta_prefetcher::train(uint32_t block, std::vector<uint32_t>& candidates){
+   uint32_t region = block >> DELTA_REGION_BITS;
+   this->accesses++;
+
+   // Find the region's entry, remembering the least recently used one to replace
+   delta_entry_t *entry = NULL;
+   delta_entry_t *lru = &this->table[0];
+   for (uint32_t i = 0; i < this->table.size(); i++) {
+      delta_entry_t& e = this->table[i];
+      if (e.valid && e.region == region) {
+         entry = &e;
+         break;
+      }
+      if (!e.valid || (lru->valid && e.last_use < lru->last_use)) {
+         lru = &e;
+      }
+   }
+
+   if (entry == NULL) {
+      lru->region = region;
+      lru->last_block = block;
+      lru->delta = 0;
+      lru->confirmed = false;
+      lru->valid = true;
+      lru->last_use = this->accesses;
+      return;
+   }
+   entry->last_use = this->accesses;
+
+   int32_t delta = (int32_t)(block - entry->last_block);
+   if (delta == 0) { return; }
+   entry->confirmed = (delta == entry->delta);
+   entry->delta = delta;
+   entry->last_block = block;
+
+   if (entry->confirmed) {
+      for (uint32_t i = 1; i <= this->degree; i++) {
+         candidates.push_back(block + (uint32_t)(delta * (int32_t) i));
+      }
+   }
+}
+
+// ------------ Class: markov_prefetcher ------------ //
+markov_prefetcher::markov_prefetcher(uint32_t table_size, uint32_t degree) : prefetcher(table_size, degree) {
+   markov_entry_t empty;
+   memset(&empty, 0, sizeof(empty));
+   this->table.assign(table_size, empty);
+   this->last_block = 0;
+   this->have_last = false;
+}
+
+void markov_prefetcher::train(uint32_t block, std::vector<uint32_t>& candidates){
+   // Record block as the most recent successor of the previous block
+   if (this->have_last) {
+      markov_entry_t& prev = this->table[this->last_block % this->table.size()];
+      if (!prev.valid || prev.block != this->last_block) {
+         prev.block = this->last_block;
+         prev.num_successors = 0;
+         prev.valid = true;
+      }
+
+      uint32_t pos = 0;
+      while (pos < prev.num_successors && prev.successors[pos] != block) { pos++; }
+      if (pos == prev.num_successors && prev.num_successors < MARKOV_SUCCESSORS) { prev.num_successors++; }
+      if (pos == MARKOV_SUCCESSORS) { pos--; }       // Full: drop the oldest successor
+      memmove(&prev.successors[1], &prev.successors[0], pos * sizeof(uint32_t));
+      prev.successors[0] = block;
+   }
+   this->last_block = block;
+   this->have_last = true;
+
+   // Predict block's own successors
+   const markov_entry_t& entry = this->table[block % this->table.size()];
+   if (entry.valid && entry.block == block) {
+      for (uint32_t i = 0; i < entry.num_successors && i < this->degree; i++) {
+         candidates.push_back(entry.successors[i]);
+      }
+   }
+}
+
+static const char *prefetcher_names[PREF_COUNT] = { "stream", "nextline", "delta", "markov" };
+
+prefetcher* make_prefetcher(prefetcher_t type, uint32_t table_size, uint32_t degree){
+   switch (type) {
+      case PREF_NEXTLINE: return new nextline_prefetcher(table_size, degree);
+      case PREF_DELTA:    return new delta_prefetcher(table_size, degree);
+      case PREF_MARKOV:   return new markov_prefetcher(table_size, degree);
+      default:            return NULL;
+   }
+}
+
+bool parse_prefetcher(const char *name, prefetcher_t& type){
+   for (int i = 0; i < PREF_COUNT; i++) {
+      if (strcmp(name, prefetcher_names[i]) == 0) {
+         type = (prefetcher_t) i;
+         return true;
+      }
+   }
+   return false;
+}
+
+const char* prefetcher_name(prefetcher_t type){
+   return (type >= 0 && type < PREF_COUNT) ? prefetcher_names[type] : "unknown";
+}
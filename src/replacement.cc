@@ -0,0 +1,208 @@
+// Replacement policies: LRU, tree-PLRU, SRRIP/BRRIP/DRRIP and random
+
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <algorithm>
+
+#include "Replacement.h"
+
+void replacement_policy::order(uint32_t set, std::vector<uint32_t>& ways){
+   (void) set;
+   ways.clear();
+   for (uint32_t way = 0; way < this->assoc; way++) {
+      ways.push_back(way);
+   }
+}
+
+// ------------ Class: lru_policy ------------ //
+lru_policy::lru_policy(uint32_t num_sets, uint32_t assoc) : replacement_policy(num_sets, assoc) {
+   lru_link_t unlinked = { LRU_NONE, LRU_NONE };
+   this->links.assign((size_t)num_sets * assoc, unlinked);
+   this->head.assign(num_sets, LRU_NONE);
+   this->tail.assign(num_sets, LRU_NONE);
+}
+
+void lru_policy::unlink(uint32_t set, uint32_t way){
+   lru_link_t *set_links = &this->links[(size_t)set * this->assoc];
+   lru_link_t& link = set_links[way];
+   if (link.prev != LRU_NONE) { set_links[link.prev].next = link.next; }
+   else { this->head[set] = link.next; }
+   if (link.next != LRU_NONE) { set_links[link.next].prev = link.prev; }
+   else { this->tail[set] = link.prev; }
+}
+
+void lru_policy::push_front(uint32_t set, uint32_t way){
+   lru_link_t *set_links = &this->links[(size_t)set * this->assoc];
+   uint32_t old_head = this->head[set];
+   set_links[way].prev = LRU_NONE;
+   set_links[way].next = old_head;
+   if (old_head != LRU_NONE) { set_links[old_head].prev = way; }
+   else { this->tail[set] = way; }
+   this->head[set] = way;
+}
+
+void lru_policy::on_hit(uint32_t set, uint32_t way){
+   if (this->head[set] == way) { return; }      // Already MRU
+   this->unlink(set, way);
+   this->push_front(set, way);
+}
+
+void lru_policy::on_fill(uint32_t set, uint32_t way, bool replacing){
+   // A way filled for the first time is not on the list yet
+   if (replacing) { this->unlink(set, way); }
+   this->push_front(set, way);
+}
+
+uint32_t lru_policy::victim(uint32_t set){
+   return this->tail[set];
+}
+
+void lru_policy::order(uint32_t set, std::vector<uint32_t>& ways){
+   ways.clear();
+   for (uint32_t way = this->head[set]; way != LRU_NONE; way = this->links[(size_t)set * this->assoc + way].next) {
+      ways.push_back(way);
+   }
+}
+
+// ------------ Class: plru_policy ------------ //
+plru_policy::plru_policy(uint32_t num_sets, uint32_t assoc) : replacement_policy(num_sets, assoc) {
+   this->words_per_set = (assoc + 63) / 64;
+   this->bits.assign((size_t)num_sets * words_per_set, 0);
+}
+
+void plru_policy::put_bit(uint32_t set, uint32_t node, bool value){
+   uint64_t& word = this->bits[(size_t)set * this->words_per_set + node / 64];
+   uint64_t mask = (uint64_t)1 << (node % 64);
+   word = value ? (word | mask) : (word & ~mask);
+}
+
+// Point every node on the way's path at the other half
+void plru_policy::touch(uint32_t set, uint32_t way){
+   uint32_t node = way + this->assoc - 1;       // Leaf
+   while (node > 0) {
+      uint32_t parent = (node - 1) / 2;
+      bool came_from_right = (node == 2 * parent + 2);
+      this->put_bit(set, parent, !came_from_right);
+      node = parent;
+   }
+}
+
+uint32_t plru_policy::victim(uint32_t set){
+   uint32_t node = 0;
+   while (node < this->assoc - 1) {
+      node = 2 * node + 1 + (this->get_bit(set, node) ? 1 : 0);
+   }
+   return node - (this->assoc - 1);
+}
+
+// ------------ Class: rrip_policy ------------ //
+rrip_policy::rrip_policy(uint32_t num_sets, uint32_t assoc, replacement_t mode) : replacement_policy(num_sets, assoc) {
+   this->rrpv.assign((size_t)num_sets * assoc, RRPV_MAX);
+   this->mode = mode;
+   this->brrip_fills = 0;
+   this->psel = (DRRIP_PSEL_MAX + 1) / 2;
+
+   // Leader sets: one SRRIP and one BRRIP leader per constituency of leader_stride
+   // sets, so at most half the sets lead and the rest follow PSEL. Fewer than
+   // DRRIP_MIN_STRIDE sets leave no followers to duel for: plain SRRIP then.
+   if (num_sets >= DRRIP_MIN_STRIDE) {
+      this->leader_stride = std::max<uint32_t>(DRRIP_MIN_STRIDE, num_sets / DRRIP_LEADERS);
+   } else {
+      this->leader_stride = 0;
+   }
+}
+
+uint8_t rrip_policy::brrip_insertion(){
+   this->brrip_fills++;
+   return (this->brrip_fills % BRRIP_EPSILON == 0) ? RRPV_MAX - 1 : RRPV_MAX;
+}
+
+void rrip_policy::on_fill(uint32_t set, uint32_t way, bool replacing){
+   (void) replacing;
+   bool use_brrip = (this->mode == REPL_BRRIP);
+
+   if (this->mode == REPL_DRRIP) {
+      if (this->leader_stride == 0) {
+         use_brrip = false;
+      } else if (set % this->leader_stride == 0) {
+         // Miss in an SRRIP leader: vote for BRRIP
+         if (this->psel < DRRIP_PSEL_MAX) { this->psel++; }
+         use_brrip = false;
+      } else if (set % this->leader_stride == this->leader_stride / 2) {
+         // Miss in a BRRIP leader: vote for SRRIP
+         if (this->psel > 0) { this->psel--; }
+         use_brrip = true;
+      } else {
+         use_brrip = this->psel > DRRIP_PSEL_MAX / 2;
+      }
+   }
+
+   this->rrpv[(size_t)set * this->assoc + way] = use_brrip ? this->brrip_insertion() : RRPV_MAX - 1;
+}
+
+uint32_t rrip_policy::victim(uint32_t set){
+   uint8_t *set_rrpv = &this->rrpv[(size_t)set * this->assoc];
+
+   // Age the whole set at once until some way reaches RRPV_MAX
+   uint8_t oldest = *std::max_element(set_rrpv, set_rrpv + this->assoc);
+   if (oldest < RRPV_MAX) {
+      for (uint32_t way = 0; way < this->assoc; way++) {
+         set_rrpv[way] += RRPV_MAX - oldest;
+      }
+   }
+   for (uint32_t way = 0; way < this->assoc; way++) {
+      if (set_rrpv[way] == RRPV_MAX) { return way; }
+   }
+   return 0;
+}
+
+void rrip_policy::order(uint32_t set, std::vector<uint32_t>& ways){
+   replacement_policy::order(set, ways);
+   const uint8_t *set_rrpv = &this->rrpv[(size_t)set * this->assoc];
+   std::stable_sort(ways.begin(), ways.end(), [set_rrpv](uint32_t a, uint32_t b){ return set_rrpv[a] < set_rrpv[b]; });
+}
+
+// ------------ Class: random_policy ------------ //
+uint32_t random_policy::victim(uint32_t set){
+   (void) set;
+   this->state ^= this->state << 13;
+   this->state ^= this->state >> 7;
+   this->state ^= this->state << 17;
+   return (uint32_t)(this->state % this->assoc);
+}
+
+// ------------ Factory ------------ //
+static const char *replacement_names[REPL_COUNT] = { "lru", "plru", "srrip", "brrip", "drrip", "random" };
+
+replacement_policy* make_replacement_policy(replacement_t type, uint32_t num_sets, uint32_t assoc){
+   switch (type) {
+      case REPL_PLRU:   return new plru_policy(num_sets, assoc);
+      case REPL_SRRIP:
+      case REPL_BRRIP:
+      case REPL_DRRIP:  return new rrip_policy(num_sets, assoc, type);
+      case REPL_RANDOM: return new random_policy(num_sets, assoc);
+      default:          return new lru_policy(num_sets, assoc);
+   }
+}
+
+bool parse_replacement(const char *name, replacement_t& type){
+   for (int i = 0; i < REPL_COUNT; i++) {
+      if (strcmp(name, replacement_names[i]) == 0) {
+         type = (replacement_t) i;
+         return true;
+      }
+   }
+   return false;
+}
+
+const char* replacement_name(replacement_t type){
+   return (type >= 0 && type < REPL_COUNT) ? replacement_names[type] : "unknown";
+}
+
+bool replacement_supports(replacement_t type, uint32_t assoc){
+   if (type == REPL_PLRU) {
+      return assoc != 0 && (assoc & (assoc - 1)) == 0;
+   }
+   return true;
+}
@@ -0,0 +1,260 @@
+// Sampled simulation: set sampling and time sampling with confidence intervals
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include <vector>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Sampling.h"
+#include "Trace.h"
+
+#define SAMPLE_LEVEL_COUNTERS 8
+
+static const char *sample_counter_names[SAMPLE_LEVEL_COUNTERS] = {
+   "reads (demand):", "read misses (demand):", "reads (prefetch):", "read misses (prefetch):",
+   "writes:", "write misses:", "writebacks:", "prefetches:"
+};
+
+// Two-sided 95% Student t quantiles for 1 .. 30 degrees of freedom
+static const double t_quantile_95[30] = {
+   12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+uint32_t sample_counter_count(const cache_hierarchy& hierarchy){
+   return hierarchy.levels.size() * SAMPLE_LEVEL_COUNTERS + 1;
+}
+
+void sample_counters(const cache_hierarchy& hierarchy, std::vector<uint64_t>& counters){
+   counters.resize(sample_counter_count(hierarchy));
+   uint64_t *c = &counters[0];
+   for (size_t i = 0; i < hierarchy.levels.size(); i++) {
+      const cache *level = hierarchy.levels[i];
+      *c++ = level->reads;
+      *c++ = level->read_miss_count;
+      *c++ = level->reads_prefetch;
+      *c++ = level->read_miss_prefetch;
+      *c++ = level->writes;
+      *c++ = level->write_miss_count;
+      *c++ = level->writeback;
+      *c++ = level->prefetches;
+   }
+   *c = hierarchy.levels.back()->memory_traffic;
+}
+
+// Murmur3 finalizer, so set groups are not chosen by a stride
+static uint32_t mix_key(uint32_t key){
+   key ^= key >> 16;
+   key *= 0x85ebca6bu;
+   key ^= key >> 13;
+   key *= 0xc2b2ae35u;
+   key ^= key >> 16;
+   return key;
+}
+
+// ------------ Class: sampled_simulation ------------ //
+sampled_simulation::sampled_simulation(const std::vector<level_params_t>& levels, const sample_params_t& params)
+   : params(params), hierarchy(levels){
+   this->requests = 0;
+   this->measured_positions = 0;
+   this->simulated = 0;
+   this->key_shift = 0;
+   this->key_bits = 0;
+
+   if (params.SET_RATE != 0) {
+      // Bits inside every level's set index: above the largest block offset, below the lowest index top
+      uint32_t low = 0, high = ADDRESSBITS;
+      for (size_t i = 0; i < this->hierarchy.levels.size(); i++) {
+         const cache *level = this->hierarchy.levels[i];
+         if (level->blockoffset_size > low) { low = level->blockoffset_size; }
+         if (level->blockoffset_size + level->index_bit_size < high) { high = level->blockoffset_size + level->index_bit_size; }
+      }
+      this->key_shift = low;
+      this->key_bits = (high > low) ? high - low : 0;
+      if (this->key_bits > SAMPLE_MAX_KEY_BITS) { this->key_bits = SAMPLE_MAX_KEY_BITS; }
+
+      uint32_t num_keys = 1u << this->key_bits;
+      this->key_unit.assign(num_keys, -1);
+      int32_t selected = 0;
+      for (uint32_t key = 0; key < num_keys; key++) {
+         if (mix_key(key) % params.SET_RATE == 0) { this->key_unit[key] = selected++; }
+      }
+      if (selected == 0 || (uint32_t) selected == num_keys) {
+         printf("Error: the hierarchy has %u set groups in common, too few to sample 1 in %u.\n", num_keys, params.SET_RATE);
+         exit(EXIT_FAILURE);
+      }
+      this->units.assign(selected, std::vector<uint64_t>(sample_counter_count(this->hierarchy), 0));
+   }
+}
+
+// Simulate one measured request and charge its counter changes to unit
+void sampled_simulation::measure(uint32_t unit, uint32_t addr, char rw){
+   sample_counters(this->hierarchy, this->before);
+   this->hierarchy.request(addr, rw);
+   sample_counters(this->hierarchy, this->after);
+   std::vector<uint64_t>& totals = this->units[unit];
+   for (size_t c = 0; c < totals.size(); c++) { totals[c] += this->after[c] - this->before[c]; }
+}
+
+void sampled_simulation::request(uint32_t addr, char rw){
+   const sample_params_t& p = this->params;
+   uint64_t phase = (p.PERIOD != 0) ? this->requests % p.PERIOD : p.WARMUP;
+   bool warming = phase < p.WARMUP;
+   bool measured = !warming && (p.PERIOD == 0 || phase < (uint64_t) p.WARMUP + p.WINDOW);
+   this->requests++;
+   if (!warming && !measured) { return; }
+
+   if (p.SET_RATE != 0) {
+      if (measured) { this->measured_positions++; }
+      int32_t unit = this->key_unit[(addr >> this->key_shift) & ((1u << this->key_bits) - 1)];
+      if (unit < 0) { return; }
+      this->simulated++;
+      if (measured) { this->measure(unit, addr, rw); }
+      else { this->hierarchy.request(addr, rw); }
+      return;
+   }
+
+   // Time sampling only: each window is a unit
+   this->simulated++;
+   if (!measured) {
+      this->hierarchy.request(addr, rw);
+      return;
+   }
+   if (phase == p.WARMUP) { sample_counters(this->hierarchy, this->before); }
+   this->hierarchy.request(addr, rw);
+   if (phase == (uint64_t) p.WARMUP + p.WINDOW - 1) {
+      sample_counters(this->hierarchy, this->after);
+      std::vector<uint64_t> window(this->after.size());
+      for (size_t c = 0; c < window.size(); c++) { window[c] = this->after[c] - this->before[c]; }
+      this->units.push_back(window);
+      this->measured_positions += p.WINDOW;
+   }
+}
+
+// Each unit stands for scale units of the population: scale is the inverse
+// of the sampled fraction of set groups times that of trace positions
+void sampled_simulation::estimate(uint32_t counter, double& total, double& half_width) const {
+   total = 0;
+   half_width = 0;
+   size_t n = this->units.size();
+   if (n == 0 || this->measured_positions == 0) { return; }
+
+   double scale = static_cast<double>(this->requests) / static_cast<double>(this->measured_positions);
+   if (this->params.SET_RATE != 0) { scale *= static_cast<double>(1u << this->key_bits) / static_cast<double>(n); }
+
+   double sum = 0;
+   for (size_t u = 0; u < n; u++) { sum += static_cast<double>(this->units[u][counter]); }
+   total = scale * sum;
+   if (n < 2) { return; }
+
+   double mean = sum / n, squares = 0;
+   for (size_t u = 0; u < n; u++) {
+      double d = static_cast<double>(this->units[u][counter]) - mean;
+      squares += d * d;
+   }
+   double stddev = sqrt(squares / (n - 1));
+   double correction = (scale > 1) ? sqrt(1 - 1 / scale) : 0;
+   double t = (n - 1 <= 30) ? t_quantile_95[n - 2] : 1.96;
+   half_width = t * scale * sqrt((double) n) * stddev * correction;
+}
+
+void sampled_simulation::print_report(const cache_hierarchy *exact) const {
+   printf("===== Sampling =====\n");
+   if (this->params.SET_RATE != 0) {
+      printf("set groups:              %zu of %u (1 in %u requested)\n", this->units.size(), 1u << this->key_bits, this->params.SET_RATE);
+   }
+   if (this->params.PERIOD != 0) {
+      printf("time windows:            %u of every %u requests after %u warm-up\n", this->params.WINDOW, this->params.PERIOD, this->params.WARMUP);
+   }
+   printf("requests:                %" PRIu64 "\n", this->requests);
+   printf("requests simulated:      %" PRIu64 " (%.2f%%)\n", this->simulated,
+      this->requests ? 100.0 * this->simulated / this->requests : 0.0);
+   printf("sample units:            %zu\n", this->units.size());
+   printf("\n");
+
+   std::vector<uint64_t> exact_counters;
+   if (exact != NULL) { sample_counters(*exact, exact_counters); }
+
+   uint32_t counter = 0, outside = 0;
+   for (size_t i = 0; i <= this->hierarchy.levels.size(); i++) {
+      bool memory = (i == this->hierarchy.levels.size());
+      printf("===== %s estimates (95%% confidence) =====\n", memory ? "Memory" : this->hierarchy.levels[i]->cache_name.c_str());
+      uint32_t count = memory ? 1 : SAMPLE_LEVEL_COUNTERS;
+      for (uint32_t k = 0; k < count; k++, counter++) {
+         double total, half_width;
+         this->estimate(counter, total, half_width);
+         printf("%-25s%.0f +- %.0f", memory ? "memory traffic:" : sample_counter_names[k], total, half_width);
+         if (exact != NULL) {
+            double actual = static_cast<double>(exact_counters[counter]);
+            bool inside = fabs(total - actual) <= half_width;
+            if (!inside) { outside++; }
+            printf("   exact %.0f, error %+.2f%%%s", actual, actual != 0 ? 100.0 * (total - actual) / actual : 0.0,
+               inside ? "" : ", outside interval");
+         }
+         printf("\n");
+      }
+      printf("\n");
+   }
+   if (exact != NULL) {
+      printf("exact counts outside the interval: %u of %u\n", outside, counter);
+   }
+}
+
+bool parse_sample_time(const char *spec, sample_params_t& params){
+   unsigned period, window, warmup;
+   if (sscanf(spec, "%u,%u,%u", &period, &window, &warmup) != 3) { return false; }
+   if (period == 0 || window == 0 || (uint64_t) window + warmup > period) { return false; }
+   params.PERIOD = period;
+   params.WINDOW = window;
+   params.WARMUP = warmup;
+   return true;
+}
+
+int run_sampled(const std::vector<level_params_t>& levels, const char *trace_file, const sample_params_t& params, bool validate){
+   pipelined_trace_reader reader;
+   mapped_trace bin_trace;
+   if (is_binary_trace(trace_file)) {
+      if (!bin_trace.open(trace_file)) {
+         printf("Error: Unable to map binary trace %s: %s\n", trace_file, bin_trace.error);
+         exit(EXIT_FAILURE);
+      }
+   } else if (!reader.open(trace_file)) {
+      printf("Error: Unable to open file %s\n", trace_file);
+      exit(EXIT_FAILURE);
+   }
+
+   printf("===== Simulator configuration =====\n");
+   print_level_config(levels);
+   printf("trace_file: %s\n", trace_file);
+   printf("\n");
+
+   sampled_simulation sample(levels, params);
+   cache_hierarchy *exact = validate ? new cache_hierarchy(levels) : NULL;
+
+   for (uint64_t i = 0; i < bin_trace.count; i++) {
+      sample.request(bin_trace.addr(i), bin_trace.rw(i));
+      if (exact != NULL) { exact->request(bin_trace.addr(i), bin_trace.rw(i)); }
+   }
+   const trace_batch_t *batch;
+   while ((batch = reader.next_batch()) != NULL) {
+      for (uint32_t i = 0; i < batch->count; i++) {
+         sample.request(batch->requests[i].addr, batch->requests[i].rw);
+         if (exact != NULL) { exact->request(batch->requests[i].addr, batch->requests[i].rw); }
+      }
+      reader.release_batch();
+   }
+   if (reader.status == TRACE_ERROR) {
+      printf("Error: %s:%" PRIu64 ": %s\n", trace_file, reader.line, reader.error);
+      exit(EXIT_FAILURE);
+   }
+
+   event_trace_close();
+   sample.print_report(exact);
+   delete exact;
+   return(0);
+}
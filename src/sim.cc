@@ -4,7 +4,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <unistd.h>
 #include <vector>
 #include <cstdint> 
 #include <iostream>
@@ -15,6 +17,18 @@
 #include <list>
 
 #include "Cache.h"
+#include "Checkpoint.h"
+#include "Geometry.h"
+#include "Hierarchy.h"
+#include "Coherence.h"
+#include "Multicore.h"
+#include "Sampling.h"
+#include "StackDistance.h"
+#include "Stats.h"
+#include "Sweep.h"
+#include "Timeline.h"
+#include "Timing.h"
+#include "Trace.h"
 
 
 /*  "argc" holds the number of command-line arguments.
@@ -22,110 +36,527 @@
 
     Example:
     ./sim 32 8192 4 262144 8 3 10 gcc_trace.txt
+    (optionally with --l1-policy <name> and/or --l2-policy <name>, see Replacement.h,
+    --prefetcher <name>, see Prefetch.h, --events <file>, see Events.h,
+    --format text|json|csv [--contents|--no-contents], see Stats.h, and
+    --timeline <file> [--interval K], see Timeline.h)
+
+    Deeper hierarchies replace the seven numbers with --hierarchy <file> or
+    repeated --level options (see Hierarchy.h):
+    ./sim --level L1,32,32768,8 --level L2,64,262144,8 --level L3,64,4194304,16 gcc_trace.txt
+
+    With --cores, one trace file per core follows; each core gets its own L1
+    in front of the shared lower levels (see Multicore.h), kept coherent with
+    --coherence msi|mesi [--directory] (see Coherence.h).
     argc = 9
     argv[0] = "./sim"
     argv[1] = "32"
     argv[2] = "8192"
     ... and so on
+
+    Benchmarks and tests that link the cache code bring their own main and
+    compile this file with -DSIM_NO_MAIN (see the Makefile).
 */
+#ifndef SIM_NO_MAIN
 int main (int argc, char *argv[]) {
-   FILE *fp;			// File pointer.
+   pipelined_trace_reader reader;	// Text traces (optionally gzip/zstd) decoded on a separate thread.
    char *trace_file;		// This variable holds the trace file name.
    cache_params_t params;	// Look at the sim.h header file for the definition of struct cache_params_t.
-   char rw;			// This variable holds the request's type (read or write) obtained from the trace.
-   uint32_t addr;		// This variable holds the request's address obtained from the trace.
-				// The header file <inttypes.h> above defines signed and unsigned integers of various sizes in a machine-agnostic way.  "uint32_t" is an unsigned integer of 32 bits.
 
-   // Exit with an error if the number of command-line arguments is incorrect.
-   if (argc != 9) {
-      printf("Error: Expected 8 command-line arguments but was provided %d.\n", (argc - 1));
+   // Sweep mode: ./sim --sweep <grid_file> <trace_file> [output_csv]
+   if (argc >= 2 && strcmp(argv[1], "--sweep") == 0) {
+      return run_sweep(argc, argv);
+   }
+
+   // Stack distance mode: ./sim --stack-distance <BLOCKSIZE> <trace_file>, see StackDistance.h
+   if (argc >= 2 && strcmp(argv[1], "--stack-distance") == 0) {
+      return run_stack_distance(argc, argv);
+   }
+
+   // Convert mode: ./sim --convert <text_trace> <binary_trace>
+   if (argc >= 2 && strcmp(argv[1], "--convert") == 0) {
+      return run_convert(argc, argv);
+   }
+
+   // Replacement policy and prefetcher options may appear anywhere; they are removed before the positional arguments are read.
+   params.L1_POLICY = REPL_LRU;
+   params.L2_POLICY = REPL_LRU;
+   params.PREFETCHER = PREF_STREAM;
+   const char *event_file = NULL;
+   const char *hierarchy_file = NULL;     // --hierarchy <file>
+   std::vector<char *> level_specs;       // --level <spec>, see Hierarchy.h
+   bool classic_options = false;          // Options that only apply to the L1/L2 command line
+   bool multicore = false;                // --cores: one trace file per core, see Multicore.h
+   interleave_t interleave = INTERLEAVE_RR;
+   coherence_t coherence = COHERENCE_NONE;
+   bool directory = false;
+   sample_params_t sample = { 0, 0, 0, 0 };      // --sample-sets / --sample-time, see Sampling.h
+   bool validate = false;
+   const char *checkpoint_file = NULL;    // --checkpoint <file>, see Checkpoint.h
+   uint64_t checkpoint_at = UINT64_MAX;   // --checkpoint-at N, default after the whole trace
+   const char *restore_file = NULL;       // --restore <file>
+   bool timing = false;                   // --timing, see Timing.h
+   timing_params_t timing_params;
+   timing_params.MSHRS = TIMING_DEFAULT_MSHRS;
+   timing_params.DRAM_LATENCY = TIMING_DEFAULT_DRAM_LATENCY;
+   timing_params.DRAM_INTERVAL = TIMING_DEFAULT_DRAM_INTERVAL;
+   timeline_params_t timeline_params = { NULL, TIMELINE_DEFAULT_INTERVAL, TIMELINE_DEFAULT_THRESHOLD };    // --timeline, see Timeline.h
+   output_params_t output = { FORMAT_TEXT, true };     // --format, --contents / --no-contents, see Stats.h
+   int contents = -1;                     // Unset: follows the format
+   int num_args = 1;
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--cores") == 0) {
+         multicore = true;
+         continue;
+      }
+      if (strcmp(argv[i], "--interleave") == 0) {
+         if (i + 1 >= argc || !parse_interleave(argv[i + 1], interleave)) {
+            printf("Error: --interleave expects rr or time.\n");
+            exit(EXIT_FAILURE);
+         }
+         i++;
+         continue;
+      }
+      if (strcmp(argv[i], "--coherence") == 0) {
+         if (i + 1 >= argc || !parse_coherence(argv[i + 1], coherence)) {
+            printf("Error: --coherence expects none, msi or mesi.\n");
+            exit(EXIT_FAILURE);
+         }
+         i++;
+         continue;
+      }
+      if (strcmp(argv[i], "--sample-sets") == 0) {
+         if (i + 1 >= argc || atoi(argv[i + 1]) < 2) {
+            printf("Error: --sample-sets expects a rate of at least 2.\n");
+            exit(EXIT_FAILURE);
+         }
+         sample.SET_RATE = (uint32_t) atoi(argv[++i]);
+         continue;
+      }
+      if (strcmp(argv[i], "--sample-time") == 0) {
+         if (i + 1 >= argc || !parse_sample_time(argv[i + 1], sample)) {
+            printf("Error: --sample-time expects PERIOD,WINDOW,WARMUP with WINDOW > 0 and WINDOW + WARMUP <= PERIOD.\n");
+            exit(EXIT_FAILURE);
+         }
+         i++;
+         continue;
+      }
+      if (strcmp(argv[i], "--format") == 0 || strncmp(argv[i], "--format=", 9) == 0) {
+         const char *name = (argv[i][8] == '=') ? argv[i] + 9 : (i + 1 < argc ? argv[++i] : "");
+         if (!parse_stats_format(name, output.FORMAT)) {
+            printf("Error: --format expects text, json or csv.\n");
+            exit(EXIT_FAILURE);
+         }
+         continue;
+      }
+      if (strcmp(argv[i], "--contents") == 0 || strcmp(argv[i], "--no-contents") == 0) {
+         contents = (argv[i][2] == 'c');
+         continue;
+      }
+      if (strcmp(argv[i], "--timing") == 0) {
+         timing = true;
+         continue;
+      }
+      if (strcmp(argv[i], "--hit-latency") == 0) {
+         if (i + 1 >= argc || !parse_hit_latency(argv[i + 1], timing_params)) {
+            printf("Error: --hit-latency expects a comma separated cycle count per level, L1 first.\n");
+            exit(EXIT_FAILURE);
+         }
+         timing = true;
+         i++;
+         continue;
+      }
+      if (strcmp(argv[i], "--mshrs") == 0) {
+         if (i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+            printf("Error: --mshrs expects at least 1.\n");
+            exit(EXIT_FAILURE);
+         }
+         timing_params.MSHRS = (uint32_t) atoi(argv[++i]);
+         timing = true;
+         continue;
+      }
+      if (strcmp(argv[i], "--dram") == 0) {
+         if (i + 1 >= argc || !parse_dram_timing(argv[i + 1], timing_params)) {
+            printf("Error: --dram expects LATENCY,INTERVAL in cycles.\n");
+            exit(EXIT_FAILURE);
+         }
+         timing = true;
+         i++;
+         continue;
+      }
+      if (strcmp(argv[i], "--timeline") == 0) {
+         if (i + 1 >= argc || argv[i + 1][0] == '-') {
+            printf("Error: --timeline expects a file to write.\n");
+            exit(EXIT_FAILURE);
+         }
+         timeline_params.FILE_NAME = argv[++i];
+         continue;
+      }
+      if (strcmp(argv[i], "--interval") == 0) {
+         if (i + 1 >= argc || strtoull(argv[i + 1], NULL, 10) == 0) {
+            printf("Error: --interval expects a positive request count.\n");
+            exit(EXIT_FAILURE);
+         }
+         timeline_params.INTERVAL = strtoull(argv[++i], NULL, 10);
+         continue;
+      }
+      if (strcmp(argv[i], "--phase-threshold") == 0) {
+         if (i + 1 >= argc || atof(argv[i + 1]) <= 0) {
+            printf("Error: --phase-threshold expects a positive number.\n");
+            exit(EXIT_FAILURE);
+         }
+         timeline_params.THRESHOLD = atof(argv[++i]);
+         continue;
+      }
+      if (strcmp(argv[i], "--checkpoint") == 0) {
+         if (i + 1 >= argc || argv[i + 1][0] == '-') {
+            printf("Error: --checkpoint expects a file to write.\n");
+            exit(EXIT_FAILURE);
+         }
+         checkpoint_file = argv[++i];
+         continue;
+      }
+      if (strcmp(argv[i], "--checkpoint-at") == 0) {
+         char *count_end = NULL;
+         if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+            checkpoint_at = strtoull(argv[i + 1], &count_end, 10);
+         }
+         if (count_end == NULL || *count_end != '\0') {
+            printf("Error: --checkpoint-at expects a request count.\n");
+            exit(EXIT_FAILURE);
+         }
+         i++;
+         continue;
+      }
+      // The checkpoint must exist, so "--restore 32 8192 ..." is not read as a file named 32
+      if (strcmp(argv[i], "--restore") == 0) {
+         if (i + 1 >= argc || argv[i + 1][0] == '-' || access(argv[i + 1], R_OK) != 0) {
+            printf("Error: --restore expects a checkpoint file.\n");
+            exit(EXIT_FAILURE);
+         }
+         restore_file = argv[++i];
+         continue;
+      }
+      if (strcmp(argv[i], "--validate") == 0) {
+         validate = true;
+         continue;
+      }
+      if (strcmp(argv[i], "--directory") == 0) {
+         directory = true;
+         continue;
+      }
+      if (strcmp(argv[i], "--events") == 0) {
+         if (i + 1 >= argc || argv[i + 1][0] == '-') {
+            printf("Error: --events expects a file to write.\n");
+            exit(EXIT_FAILURE);
+         }
+         event_file = argv[++i];
+         continue;
+      }
+      if (strcmp(argv[i], "--hierarchy") == 0) {
+         if (i + 1 >= argc || argv[i + 1][0] == '-') {
+            printf("Error: --hierarchy expects a file name.\n");
+            exit(EXIT_FAILURE);
+         }
+         hierarchy_file = argv[++i];
+         continue;
+      }
+      if (strcmp(argv[i], "--level") == 0) {
+         if (i + 1 >= argc || argv[i + 1][0] == '-') {
+            printf("Error: --level expects a level description.\n");
+            exit(EXIT_FAILURE);
+         }
+         level_specs.push_back(argv[++i]);
+         continue;
+      }
+      if (strcmp(argv[i], "--prefetcher") == 0) {
+         prefetcher_t prefetcher;
+         if (i + 1 >= argc || !parse_prefetcher(argv[i + 1], prefetcher)) {
+            printf("Error: --prefetcher expects one of stream, nextline, delta, markov.\n");
+            exit(EXIT_FAILURE);
+         }
+         params.PREFETCHER = prefetcher;
+         classic_options = true;
+         i++;
+         continue;
+      }
+      if (strcmp(argv[i], "--l1-policy") == 0 || strcmp(argv[i], "--l2-policy") == 0) {
+         replacement_t policy;
+         if (i + 1 >= argc || !parse_replacement(argv[i + 1], policy)) {
+            printf("Error: %s expects one of lru, plru, srrip, brrip, drrip, random.\n", argv[i]);
+            exit(EXIT_FAILURE);
+         }
+         if (argv[i][3] == '1') { params.L1_POLICY = policy; }
+         else { params.L2_POLICY = policy; }
+         classic_options = true;
+         i++;
+      } else {
+         argv[num_args++] = argv[i];
+      }
+   }
+   argc = num_args;
+
+   // Arbitrary-depth hierarchy: every level comes from --hierarchy / --level, the trace is the only argument
+   std::vector<level_params_t> levels;
+   bool classic = (hierarchy_file == NULL && level_specs.empty());
+   if (!classic) {
+      if (classic_options) {
+         printf("Error: --l1-policy, --l2-policy and --prefetcher do not apply to --hierarchy/--level; set them per level.\n");
+         exit(EXIT_FAILURE);
+      }
+      if (argc != 2 && !(multicore && argc > 2)) {
+         printf("Error: Expected the trace file as the only argument but was provided %d.\n", (argc - 1));
+         exit(EXIT_FAILURE);
+      }
+      trace_file = argv[1];
+      if (hierarchy_file != NULL && !parse_hierarchy_file(hierarchy_file, levels)) {
+         exit(EXIT_FAILURE);
+      }
+      for (size_t i = 0; i < level_specs.size(); i++) {
+         level_params_t level;
+         if (!parse_level_spec(level_specs[i], ",", level)) {
+            exit(EXIT_FAILURE);
+         }
+         levels.push_back(level);
+      }
+      if (!valid_hierarchy(levels)) {
+         exit(EXIT_FAILURE);
+      }
+   } else {
+      // Exit with an error if the number of command-line arguments is incorrect.
+      if (argc != 9 && !(multicore && argc > 9)) {
+         printf("Error: Expected 8 command-line arguments but was provided %d.\n", (argc - 1));
+         exit(EXIT_FAILURE);
+      }
+
+      // "atoi()" (included by <stdlib.h>) converts a string (char *) to an integer (int).
+      params.BLOCKSIZE = (uint32_t) atoi(argv[1]);
+      params.L1_SIZE   = (uint32_t) atoi(argv[2]);
+      params.L1_ASSOC  = (uint32_t) atoi(argv[3]);
+      params.L2_SIZE   = (uint32_t) atoi(argv[4]);
+      params.L2_ASSOC  = (uint32_t) atoi(argv[5]);
+      params.PREF_N    = (uint32_t) atoi(argv[6]);
+      params.PREF_M    = (uint32_t) atoi(argv[7]);
+      trace_file       = argv[8];
+
+      if (!replacement_supports((replacement_t) params.L1_POLICY, params.L1_ASSOC) ||
+          (params.L2_SIZE != 0 && !replacement_supports((replacement_t) params.L2_POLICY, params.L2_ASSOC))) {
+         printf("Error: plru replacement needs a power-of-two associativity.\n");
+         exit(EXIT_FAILURE);
+      }
+      classic_levels(params, levels);
+   }
+
+   if ((coherence != COHERENCE_NONE || directory) && !multicore) {
+      printf("Error: --coherence and --directory need --cores.\n");
       exit(EXIT_FAILURE);
    }
-    
-   // "atoi()" (included by <stdlib.h>) converts a string (char *) to an integer (int).
-   params.BLOCKSIZE = (uint32_t) atoi(argv[1]);
-   params.L1_SIZE   = (uint32_t) atoi(argv[2]);
-   params.L1_ASSOC  = (uint32_t) atoi(argv[3]);
-   params.L2_SIZE   = (uint32_t) atoi(argv[4]);
-   params.L2_ASSOC  = (uint32_t) atoi(argv[5]);
-   params.PREF_N    = (uint32_t) atoi(argv[6]);
-   params.PREF_M    = (uint32_t) atoi(argv[7]);
-   trace_file       = argv[8];
-
-   // Open the trace file for reading.
-   fp = fopen(trace_file, "r");
-   if (fp == (FILE *) NULL) {
-      // Exit with an error if file open failed.
-      printf("Error: Unable to open file %s\n", trace_file);
+   bool sampled = (sample.SET_RATE != 0 || sample.PERIOD != 0);
+   if (validate && !sampled) {
+      printf("Error: --validate needs --sample-sets or --sample-time.\n");
       exit(EXIT_FAILURE);
    }
-    
-   // Print simulator configuration.
-   printf("===== Simulator configuration =====\n");
-   printf("BLOCKSIZE:  %u\n", params.BLOCKSIZE);
-   printf("L1_SIZE:    %u\n", params.L1_SIZE);
-   printf("L1_ASSOC:   %u\n", params.L1_ASSOC);
-   printf("L2_SIZE:    %u\n", params.L2_SIZE);
-   printf("L2_ASSOC:   %u\n", params.L2_ASSOC);
-   printf("PREF_N:     %u\n", params.PREF_N);
-   printf("PREF_M:     %u\n", params.PREF_M);
-   printf("trace_file: %s\n", trace_file);
-   printf("\n");
-
-
-   // Only create L2 cache if L2_SIZE != 0
-   cache* L2 = NULL;
-   uint32_t tempN = 0;
-   uint32_t tempM = 0;
-   if (params.L2_SIZE != 0){
-      L2 = new cache(params.BLOCKSIZE, params.L2_SIZE, params.L2_ASSOC, params.PREF_N, params.PREF_M, NULL, "L2");
+   if (sampled && multicore) {
+      printf("Error: --sample-sets and --sample-time do not apply to --cores.\n");
+      exit(EXIT_FAILURE);
+   }
+   if ((checkpoint_file != NULL || restore_file != NULL) && (multicore || sampled)) {
+      printf("Error: --checkpoint and --restore do not apply to --cores or sampled runs.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (timing && (multicore || sampled)) {
+      printf("Error: --timing does not apply to --cores or sampled runs.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (timeline_params.FILE_NAME != NULL && (multicore || sampled)) {
+      printf("Error: --timeline does not apply to --cores or sampled runs.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (timing_params.HIT_LATENCY.size() > levels.size()) {
+      printf("Error: --hit-latency lists %u levels but the hierarchy has %u.\n", (unsigned) timing_params.HIT_LATENCY.size(), (unsigned) levels.size());
+      exit(EXIT_FAILURE);
+   }
+   timing_level_defaults(timing_params, levels.size());
+   if (checkpoint_at != UINT64_MAX && checkpoint_file == NULL) {
+      printf("Error: --checkpoint-at needs --checkpoint <file>.\n");
+      exit(EXIT_FAILURE);
+   }
+   output.CONTENTS = (contents < 0) ? (output.FORMAT == FORMAT_TEXT) : (contents == 1);
+   if (output.FORMAT == FORMAT_CSV && output.CONTENTS) {
+      printf("Error: --contents needs --format text or json.\n");
+      exit(EXIT_FAILURE);
+   }
+   if ((output.FORMAT != FORMAT_TEXT || contents >= 0) && sampled) {
+      printf("Error: --format and --contents do not apply to sampled runs.\n");
+      exit(EXIT_FAILURE);
+   }
+   if (event_file != NULL) { open_event_trace(event_file); }
+
+   if (sampled) {
+      return run_sampled(levels, trace_file, sample, validate);
+   }
+
+   // Multi-core: every remaining argument is one core's trace
+   if (multicore) {
+      std::vector<const char *> trace_files(argv + (classic ? 8 : 1), argv + argc);
+      return run_multicore(levels, trace_files, interleave, coherence, directory, output);
+   }
+
+   // Open the trace file for reading. Binary traces are memory-mapped instead.
+   mapped_trace bin_trace;
+   if (is_binary_trace(trace_file)) {
+      if (!bin_trace.open(trace_file)) {
+         printf("Error: Unable to map binary trace %s: %s\n", trace_file, bin_trace.error);
+         exit(EXIT_FAILURE);
+      }
    } else {
-      // If there is NOT a L2 cache then set prefetch for L1
-      tempN = params.PREF_N;
-      tempM = params.PREF_M;
-   }
-   cache L1(params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, tempN, tempM, L2, "L1");
-   // set prefetch unit status
-   if(params.PREF_N == 0 && params.PREF_M == 0){
-      L1.prefetch_enabled = false;
-   }
-
-   // Read requests from the trace file and echo them back.
-   while (fscanf(fp, "%c %x\n", &rw, &addr) == 2) {	// Stay in the loop if fscanf() successfully parsed two tokens as specified.
-   //    if (rw == 'r')
-   //       printf("r %x\n", addr);
-   //    else if (rw == 'w')
-   //       printf("w %x\n", addr);
-   //    else {
-   //       printf("Error: Unknown request type %c.\n", rw);
-	//  exit(EXIT_FAILURE);
-   //    }
-   
+      if (!reader.open(trace_file)) {
+         // Exit with an error if file open failed.
+         printf("Error: Unable to open file %s\n", trace_file);
+         exit(EXIT_FAILURE);
+      }
+   }
+    
+   // Print simulator configuration (machine-readable formats report it with the stats).
+   if (output.FORMAT == FORMAT_TEXT) {
+      printf("===== Simulator configuration =====\n");
+      if (!classic) {
+         print_level_config(levels);
+      } else {
+         printf("BLOCKSIZE:  %u\n", params.BLOCKSIZE);
+         printf("L1_SIZE:    %u\n", params.L1_SIZE);
+         printf("L1_ASSOC:   %u\n", params.L1_ASSOC);
+         printf("L2_SIZE:    %u\n", params.L2_SIZE);
+         printf("L2_ASSOC:   %u\n", params.L2_ASSOC);
+         printf("PREF_N:     %u\n", params.PREF_N);
+         printf("PREF_M:     %u\n", params.PREF_M);
+         if (params.L1_POLICY != REPL_LRU) { printf("L1_POLICY:  %s\n", replacement_name((replacement_t) params.L1_POLICY)); }
+         if (params.L2_POLICY != REPL_LRU) { printf("L2_POLICY:  %s\n", replacement_name((replacement_t) params.L2_POLICY)); }
+         if (params.PREFETCHER != PREF_STREAM) { printf("PREFETCHER: %s\n", prefetcher_name((prefetcher_t) params.PREFETCHER)); }
+      }
+      printf("trace_file: %s\n", trace_file);
+      printf("\n");
+   }
+
+
+   // Build the levels, L1 first (for the classic command line, L1 and L2 if L2_SIZE != 0)
+   cache_hierarchy hierarchy(levels);
+   cache& L1 = *hierarchy.L1;
+
+   // A restored checkpoint resumes after the requests it had already simulated
+   uint64_t resume_at = 0;
+   if (restore_file != NULL && !checkpoint_restore(restore_file, hierarchy, resume_at)) {
+      exit(EXIT_FAILURE);
+   }
+   timing_model *timer = timing ? new timing_model(hierarchy, timing_params) : NULL;
+   interval_timeline *timeline = (timeline_params.FILE_NAME != NULL) ? new interval_timeline(hierarchy, timeline_params, resume_at) : NULL;
+   bool checkpointed = false;
+   auto checkpoint = [&](uint64_t trace_offset) {
+      if (!checkpoint_save(checkpoint_file, hierarchy, trace_offset)) { exit(EXIT_FAILURE); }
+      checkpointed = true;
+   };
+
+   // Simulate trace requests [position, position + count). Without --timing they go to the
+   // hierarchy in batches, cut short at the checkpoint and at each timeline snapshot.
+   auto simulate = [&](const trace_request_t *requests, uint64_t position, size_t count) {
+      size_t done = 0;
+      while (done < count) {
+         uint64_t at = position + done;
+         if (at == checkpoint_at && checkpoint_file != NULL) { checkpoint(at); }
+         size_t n = count - done;
+         if (checkpoint_file != NULL && checkpoint_at > at) { n = (size_t) std::min<uint64_t>(n, checkpoint_at - at); }
+         if (timeline != NULL) { n = (size_t) std::min<uint64_t>(n, timeline->next - at); }
+
+         if (timer != NULL) {
+            for (size_t i = done; i < done + n; i++) { timer->request(requests[i].addr, requests[i].rw); }
+         } else {
+            hierarchy.request_batch(requests + done, n);
+         }
+         done += n;
+         if (timeline != NULL) { timeline->tick(position + done); }
+      }
+   };
+
+   // Binary trace: no parsing, just walk the mapping a batch at a time
+   trace_request_t decoded[HIERARCHY_BATCH_SIZE];
+   for (uint64_t i = resume_at; i < bin_trace.count; ) {
+      size_t n = (size_t) std::min<uint64_t>(bin_trace.count - i, HIERARCHY_BATCH_SIZE);
+      for (size_t k = 0; k < n; k++) {
+         decoded[k].addr = bin_trace.addr(i + k);
+         decoded[k].rw = bin_trace.rw(i + k);
+      }
+      simulate(decoded, i, n);
+      i += n;
+   }
 
-      L1.request(addr, rw); 
+   // Consume text trace batches as the decode thread produces them. Unknown request types and malformed addresses are errors.
+   const trace_batch_t *batch;
+   uint64_t position = 0;      // Index of the batch's first request in the trace
+   while ((batch = reader.next_batch()) != NULL) {
+      uint32_t first = (resume_at > position) ? (uint32_t) std::min<uint64_t>(resume_at - position, batch->count) : 0;
+      simulate(batch->requests + first, position + first, batch->count - first);
+      position += batch->count;
+      reader.release_batch();
    }
+   if (reader.status == TRACE_ERROR) {
+      printf("Error: %s:%" PRIu64 ": %s\n", trace_file, reader.line, reader.error);
+      exit(EXIT_FAILURE);
+   }
+
+   // Default (or past the end): checkpoint after the whole trace
+   uint64_t trace_end = std::max(std::max(bin_trace.count, position), resume_at);
+   if (checkpoint_file != NULL && !checkpointed) {
+      checkpoint(trace_end);
+   }
+   if (timeline != NULL) { timeline->finish(trace_end); }
+
    // --------- Print final stats ---------- //
       
-   L1.print_cache_stats();
-   if(L2 != NULL) { (*L2).print_cache_stats(); }
-   if(L1.prefetch_enabled){ L1.printStreamBuffer(); }
-   if(L2 != NULL && L2->prefetch_enabled){ (*L2).printStreamBuffer(); }
-   L1.print_cache_measurements();
+   event_trace_close();
+   if (output.FORMAT == FORMAT_TEXT) {
+      if (output.CONTENTS) { hierarchy.print_contents(); }
+      if (classic) { L1.print_cache_measurements(); }
+      else { hierarchy.print_measurements(); }
+      if (timer != NULL) { timer->print_measurements(); }
+   } else {
+      stats_registry memory, timing_stats;
+      std::vector<const stats_registry*> groups;
+      register_memory_stats(memory, hierarchy.levels.back());
+      groups.push_back(&memory);
+      if (timer != NULL) {
+         timer->register_stats(timing_stats);
+         groups.push_back(&timing_stats);
+      }
+      std::vector<const char *> trace_files(1, trace_file);
+      write_stats(stdout, output.FORMAT, trace_files, hierarchy.levels, groups, output.CONTENTS);
+   }
+   if (timeline != NULL) {
+      // Keeps the json/csv output on stdout parseable
+      timeline->print_phases(output.FORMAT == FORMAT_TEXT ? stdout : stderr);
+      delete timeline;
+   }
+   delete timer;
 
    return(0);
 }
+#endif
 
 
-// ------------ Class: cache_set ------------ //
-std::vector<cache_block>* cache_set::getCacheSet(){
-    return &this->set;
-}
-
-uint32_t cache_set::getLRU_max(){
-   return this->LRU_max;
+// --events <file>: only available in builds with tracing compiled in
+void open_event_trace(const char *event_file){
+#ifdef TRACE_EVENTS
+   if (!event_trace_open(event_file)) {
+      printf("Error: Unable to open file %s\n", event_file);
+      exit(EXIT_FAILURE);
+   }
+#else
+   (void) event_file;
+   printf("Error: --events needs a simulator built with \"make EVENTS=1\".\n");
+   exit(EXIT_FAILURE);
+#endif
 }
 
-// ------------ Class: cache_array ------------ //
+// ------------ Class: cache ------------ //
 // Calculate address tag
 uint32_t cache::parse_tag(uint32_t addr){
    // Shift addr
@@ -153,41 +584,94 @@ uint32_t cache::parse_offset(uint32_t addr){
    return block_offset_mask & addr;
 }
 
-void cache::print_cache_stats(){
-   std::cout << "===== " << this->cache_name << " contents =====\n";
-
-   for (int i = 0; i < (int)this->cache_array.size(); i++) {   // Iterate over all sets
-      std::cout << std::dec << "set      " << i << ":    ";
-
-      int array_size = (int)this->assoc;        // Number of blocks in each set
+// Everything that changes while simulating; the configuration is rebuilt from the command line
+void cache::state_spans(std::vector<state_span_t>& spans){
+   state_span(spans, this->tags);
+   state_span(spans, this->valid_bits);
+   state_span(spans, this->dirty_bits);
+   this->policy->state_spans(spans);
+
+   state_value(spans, this->reads);
+   state_value(spans, this->writes);
+   state_value(spans, this->read_miss_count);
+   state_value(spans, this->write_miss_count);
+   state_value(spans, this->memory_traffic);
+   state_value(spans, this->prefetches);
+   state_value(spans, this->reads_prefetch);
+   state_value(spans, this->read_miss_prefetch);
+   state_value(spans, this->writeback);
+   state_value(spans, this->prefetches_useful);
+   state_value(spans, this->prefetches_late);
+   state_value(spans, this->prefetches_polluting);
+
+   if (this->prefetch_engine != NULL) {
+      state_span(spans, this->prefetched_bits);
+      state_span(spans, this->prefetch_ready);
+      state_span(spans, this->pollution_filter);
+      this->prefetch_engine->state_spans(spans);
+   } else {
+      state_span(spans, this->prefetch_Unit->streamBuffers);
+   }
+}
 
-      // Initialize blockArray with nullptrs
-      cache_block* blockArray[array_size];
-      for (int idx = 0; idx < array_size; idx++) {
-          blockArray[idx] = nullptr;
+// A top level's miss rate counts reads and writes; lower levels count demand
+// reads only, since their writes are writebacks.
+void cache::register_stats(){
+   this->stats.group = this->cache_name;
+   this->stats.counter("reads", "reads (demand):", this->reads);
+   this->stats.counter("read_misses", "read misses (demand):", this->read_miss_count);
+   this->stats.counter("reads_prefetch", "reads (prefetch):", this->reads_prefetch);
+   this->stats.counter("read_misses_prefetch", "read misses (prefetch):", this->read_miss_prefetch);
+   this->stats.counter("writes", "writes:", this->writes);
+   this->stats.counter("write_misses", "write misses:", this->write_miss_count);
+   this->stats.rate("miss_rate", "miss rate:", [this]() {
+      if (this->level <= 1) {
+         uint64_t accesses = this->reads + this->writes;
+         return accesses ? static_cast<double>(this->read_miss_count + this->write_miss_count) / static_cast<double>(accesses) : 0.0;
       }
+      return this->reads ? static_cast<double>(this->read_miss_count) / static_cast<double>(this->reads) : 0.0;
+   });
+   this->stats.counter("writebacks", "writebacks:", this->writeback);
+   this->stats.counter("prefetches", "prefetches:", this->prefetches);
+   // Stream buffer hits count as useful too; only the engines track late and polluting fills
+   if (this->prefetch_enabled) {
+      this->stats.counter("prefetches_useful", "useful prefetches:", this->prefetches_useful);
+   }
+   if (this->prefetch_engine != NULL) {
+      this->stats.counter("prefetches_late", "late prefetches:", this->prefetches_late);
+      this->stats.counter("prefetches_polluting", "polluting prefetches:", this->prefetches_polluting);
+   }
+}
 
-      // Populate blockArray based on LRUCounter
-      for (int j = 0; j < (int)this->cache_array[i].set.size(); j++){
-         uint32_t lru = this->cache_array[i].set[j].LRUCounter;
+// Shared level of a multi-core run; the per-core counters are registered once, sized here
+void cache::track_owners(uint32_t num_cores){
+   this->owner.assign((size_t)this->num_sets * this->assoc, 0);
+   this->interference_evictions.assign(num_cores, 0);
+   this->stats.counter("interference_evictions", "interference evictions:", this->interference_total);
+   for (uint32_t core = 0; core < num_cores; core++) {
+      char key[48], label[32];
+      snprintf(key, sizeof(key), "interference_evictions_core%u", core);
+      snprintf(label, sizeof(label), "   core%u:", core);
+      this->stats.counter(key, label, this->interference_evictions[core]);
+   }
+}
 
-         // Ensure lru is within bounds
-         if (lru < array_size) {
-             blockArray[lru] = &this->cache_array[i].set[j];
-         }
-      }
+void cache::print_cache_stats(){
+   std::cout << "===== " << this->cache_name << " contents =====\n";
 
-      // Print the blocks in order
-      for (int k = 0; k < array_size; k++) {
-         cache_block* block = blockArray[k];
+   std::vector<uint32_t> ways;
+   for (int i = 0; i < (int)this->num_sets; i++) {   // Iterate over all sets
+      std::cout << std::dec << "set      " << i << ":    ";
 
-         if (block != nullptr && block->valid) {
-             // Safe to access block
-             char D = (block->dirty) ? 'D' : ' ';
+      // Print the valid blocks from most to least protected (MRU to LRU for LRU)
+      this->policy->order(i, ways);
+      for (uint32_t k = 0; k < ways.size(); k++) {
+         uint32_t way = ways[k];
+         if (!this->is_valid(i, way)) { continue; }
+         char D = this->is_dirty(i, way) ? 'D' : ' ';
 
-             // Convert tag to hex and print
-             std::cout << std::hex << this->parse_tag(block->data) << " " << D << "   ";
-         }
+         // Convert tag to hex and print
+         std::cout << std::hex << this->tags[this->slot(i, way)] << " " << D << "   ";
       }
       std::cout << std::dec << std::endl; // new line for each set
    }
@@ -252,38 +736,127 @@ void cache::print_cache_measurements(){
 
        std::cout << "q. memory traffic:             " << this->memory_traffic << std::endl;
    }
+
+   // Prefetch effectiveness, for the engines that prefetch into the cache
+   const cache *levels[2] = { this, this->level_below };
+   for (int i = 0; i < 2; i++) {
+       const cache *level = levels[i];
+       if (level == NULL || level->prefetch_engine == NULL) { continue; }
+       std::cout << "r. " << level->cache_name << " useful prefetches:       " << level->prefetches_useful << std::endl;
+       std::cout << "s. " << level->cache_name << " late prefetches:         " << level->prefetches_late << std::endl;
+       std::cout << "t. " << level->cache_name << " polluting prefetches:    " << level->prefetches_polluting << std::endl;
+   }
 }
 
-void cache::update_lru(uint32_t current_LRUcounter, uint32_t addr, std::vector<cache_block> *setptr, int set_index){
+// Function to install block
+void cache::install_block(uint32_t set, uint32_t way, uint32_t addr, char rw){
+   if (this->is_valid(set, way)) { TRACE_EVENT(EV_EVICT, this->level, set, way, this->block_address(set, way)); }
+   TRACE_EVENT(EV_FILL, this->level, set, way, addr & ~((1u << this->blockoffset_size) - 1));
+
+   // Multi-core shared level: evicting another core's block is interference
+   if (!this->owner.empty()) {
+      uint16_t& owner = this->owner[this->slot(set, way)];
+      if (this->is_valid(set, way) && owner != this->requester) {
+         this->interference_evictions[owner]++;
+         this->interference_total++;
+      }
+      owner = (uint16_t) this->requester;
+   }
+
+   // Coherent private cache: the directory stops listing this core for the old block
+   if (this->coherence != NULL) {
+      if (this->is_valid(set, way)) { this->coherence->on_evict(this->core_id, this->block_address(set, way)); }
+      this->set_exclusive(set, way, false);
+   }
+
+   // Install block
+   this->tags[this->slot(set, way)] = this->parse_tag(addr);
+   this->set_dirty(set, way, rw == 'w');      // Set dirty bit if write, else install clean
+   this->policy->on_fill(set, way, this->is_valid(set, way));    // Update replacement state
+   this->set_valid(set, way);                 // Mark block as valid
+   if (this->prefetch_engine != NULL) { this->set_prefetched(set, way, false); }
+}
+
+// Look up a tag in a set, 64 ways per kernel call. On a hit way is the matching
+// way; on a miss it is the way to replace: the first invalid way, else the policy's victim.
+bool cache::lookup(uint32_t set, uint32_t tag, uint32_t& way){
+   const uint32_t *set_tags = &this->tags[this->slot(set, 0)];
+   const uint64_t *set_valid = &this->valid_bits[set * this->bitmap_words];
+
+   bool found_invalid = false;
+   uint32_t invalid_index = 0;
+   for (uint32_t w = 0; w < this->bitmap_words; w++){
+      uint32_t base = w * 64;
+      uint32_t num_ways = (this->assoc - base < 64) ? this->assoc - base : 64;
+      way_masks_t masks = this->match_ways(set_tags + base, set_valid[w], num_ways, tag);
+
+      if (masks.hit != 0){
+         way = base + __builtin_ctzll(masks.hit);
+         return true;
+      }
+      if (!found_invalid && masks.invalid != 0){
+         found_invalid = true;
+         invalid_index = base + __builtin_ctzll(masks.invalid);
+      }
+   }
+   way = found_invalid ? invalid_index : this->policy->victim(set);
+   return false;
+}
 
-   // Increment the counters of other blocks in set whose 
-   // counters are less than the referenced block's counter.
-   for (uint32_t i = 0; i < setptr->size(); i++){
-      // If LRU counter is less than the referenced blocks counter and it is not the same block being replaced then update LRU
-      if(((*setptr)[i].LRUCounter < current_LRUcounter)){
-         (*setptr)[i].LRUCounter++;       // Increment LRU
+// Probe for addr's block without touching replacement state (coherence snoops)
+bool cache::find_block(uint32_t addr, uint32_t& set, uint32_t& way){
+   set = this->parse_index(addr);
+   uint32_t tag = this->parse_tag(addr);
+   const uint32_t *set_tags = &this->tags[this->slot(set, 0)];
+   const uint64_t *set_valid = &this->valid_bits[set * this->bitmap_words];
+   for (uint32_t w = 0; w < this->bitmap_words; w++){
+      uint32_t base = w * 64;
+      uint32_t num_ways = (this->assoc - base < 64) ? this->assoc - base : 64;
+      way_masks_t masks = this->match_ways(set_tags + base, set_valid[w], num_ways, tag);
+      if (masks.hit != 0){
+         way = base + __builtin_ctzll(masks.hit);
+         return true;
       }
    }
-   // Update current block
-   (*setptr)[set_index].LRUCounter = 0;
-   return;
+   return false;
 }
 
-// Function to install block
-void cache::install_block(int index, uint32_t addr, std::vector<cache_block> *setptr, char rw){
-   // Install block
-   (*setptr)[index].data = addr;                 // Update address
-   (*setptr)[index].tag = this->parse_tag(addr);
-   (*setptr)[index].dirty = (rw == 'w') ? true : false;    // Set dirty bit if write, else install clean
-   (*setptr)[index].valid = true;                   // Mark block as valid
-   this->update_lru((*setptr)[index].LRUCounter, addr, setptr, index);    // Update LRU
+// Drop a block without replacing it; write_back sends dirty data to the level below first
+void cache::invalidate_block(uint32_t set, uint32_t way, bool write_back){
+   if (write_back) { this->writeback_logic(set, way); }
+   this->set_dirty(set, way, false);
+   this->valid_bits[set * this->bitmap_words + way / 64] &= ~((uint64_t)1 << (way % 64));
+   this->policy->on_invalidate(set, way);
+   if (!this->exclusive_bits.empty()) { this->set_exclusive(set, way, false); }
+   if (this->prefetch_engine != NULL) { this->set_prefetched(set, way, false); }
 }
 
-void cache::writeback_logic(uint32_t addr, uint32_t evict_index, std::vector<cache_block> *setptr){
-   if((*setptr)[evict_index].dirty){   // Check if evict block is dirty, if so writeback
+// A level never reads the state of the levels below it, so running this level over
+// the whole batch and then the level below over what it sent, in the order sent,
+// leaves every level as the interleaved request() calls would
+void cache::request_batch(const trace_request_t *requests, size_t count){
+   if (this->level_below == NULL) {
+      for (size_t i = 0; i < count; i++) { (this->*request_fn)(requests[i].addr, requests[i].rw); }
+      return;
+   }
+
+   this->batch_below.clear();
+   this->batching = true;
+   for (size_t i = 0; i < count; i++) { (this->*request_fn)(requests[i].addr, requests[i].rw); }
+   this->batching = false;
+   this->level_below->request_batch(this->batch_below.data(), this->batch_below.size());
+}
+
+void cache::queue_below(uint32_t addr, char rw){
+   this->batch_below.push_back({addr, rw});
+}
+
+void cache::writeback_logic(uint32_t set, uint32_t way){
+   if(this->is_dirty(set, way)){   // Check if evict block is dirty, if so writeback
+      TRACE_EVENT(EV_WRITEBACK, this->level, set, way, this->block_address(set, way));
       // Write back to lower level before replacing
       if (this->level_below != NULL){ 
-         this->level_below->request((*setptr)[evict_index].data, 'w'); 
+         this->send_below(this->block_address(set, way), 'w');
       } else {
          this->memory_traffic++;
       }
@@ -291,211 +864,128 @@ void cache::writeback_logic(uint32_t addr, uint32_t evict_index, std::vector<cac
    }
 }
 
-bool cache::searchStreamBuffer(uint32_t addr, streamBuffer* streamBuffer){
+// Search the stream buffers MRU first. On a hit index is the buffer holding the block.
+bool cache::searchStreamBuffer(uint32_t addr, uint32_t& index){
    // Calculate search address
    uint32_t search_addr = addr >> this->blockoffset_size;
 
-   // Reference to the stream queue for convenience
-   std::deque<streamBlock>& streamQueue = streamBuffer->streamQueue;
-
-   // Check if the stream buffer is empty
-   if(streamQueue.empty()){
-      // set valid bit to false
-      streamBuffer->valid = false;
-      return false;
-   }
-
-   // check to make sure that the stream buffer is not over the max size
-   if((int)streamQueue.size() > this->prefetch_Unit->M){
-      std::cout << "Stream buffer is over the max size" << std::endl;
-      return false;
-   }
-
-   // Search stream buffer
-   std::deque<streamBlock>::iterator it;  // Iterator for the stream buffer
-
-   for (it = streamQueue.begin(); it != streamQueue.end(); ++it) {
-      const streamBlock& block = *it;     // Get the current block
-      if (block.address == search_addr) { // If the current block is the search address
-
-         uint32_t hit_index = block.address;
-
-         // Remove all blocks up to and including the hit block
-         streamQueue.erase(streamQueue.begin(), it + 1);
-
-         // Check if the stream buffer is empty
-         if(streamQueue.empty()){
-            // set valid bit to false
-            streamBuffer->valid = false;
-         }
+   for (int i = 0; i < this->prefetch_Unit->N; i++) {
+      if (this->prefetch_Unit->streamBuffers[i].holds(search_addr)) {
+         index = i;
          return true;
       }
    }
    return false;
 }
 
-// Initialize stream buffer
-void cache::initializeStreamBuffer(uint32_t addr, streamBuffer* streamBuffer){
-
-   bool prefetch_from_lower_cache = false;
-
-   // Clear the stream buffer
-   streamBuffer->streamQueue.clear();
-
-   // Check if prefetch unit is not the lowest cache level
-   if(this->level_below != NULL){
-      std::cout << "Prefetching from lower cache" << std::endl;
-      prefetch_from_lower_cache = true;
-   } 
-
-   // Create temp address
-   uint32_t tempAddr = addr >> this->blockoffset_size;
-
-   // Fill the stream buffer with new blocks starting from addr to addr + M - 1
-   for (int i = 0; i < this->prefetch_Unit->M; i++) {
-
-      // check if the stream buffer is over the max size
-      if(this->prefetch_Unit->M <= (int)streamBuffer->streamQueue.size()){
-         //std::cout << "Stream buffer is over the max size" << std::endl;
-         break;
-      }
-
+// Prefetch blocks first .. last (block numbers) from the level below, or memory
+void cache::prefetchBlocks(uint32_t first, uint32_t last){
+   for (uint32_t block = first; block <= last; block++) {
       // Increment prefetches
       this->prefetches++;
+      TRACE_EVENT(EV_PREFETCH, this->level, this->parse_index(block << this->blockoffset_size), EVENT_NO_WAY, block << this->blockoffset_size);
+      if (this->timing != NULL) { this->timing->on_prefetch(this, block); }
 
-      uint32_t newAddress = tempAddr + i + 1;
-      streamBuffer->streamQueue.push_back(newAddress);
-
-      if(prefetch_from_lower_cache){
+      if(this->level_below != NULL){
          // Send prefetch request to lower cache
-         this->level_below->request(newAddress, 'r');
+         this->send_below(block << this->blockoffset_size, 'p');
       } else {
          // Send prefetch request to memory
          this->memory_traffic++;
       }
-   } 
-   // Set valid bit
-   streamBuffer->valid = true;
+   }
+}
 
-   // all other stream buffers are now one less recently used
-   for(int i = 0; i <= this->prefetch_Unit->N; i++){
-      if(this->prefetch_Unit->streamBuffers[i].lruStreamBuffer > streamBuffer->lruStreamBuffer){
-         this->prefetch_Unit->streamBuffers[i].lruStreamBuffer--;
-         
-         // Check to make sure that LRU value is not negative
-         if(this->prefetch_Unit->streamBuffers[i].lruStreamBuffer < 0){
-            this->prefetch_Unit->streamBuffers[i].lruStreamBuffer = 0;
-         }
-      }
-   }  
+// Initialize stream buffer: the least recently used buffer now holds the M blocks after addr
+void cache::initializeStreamBuffer(uint32_t addr){
+   uint32_t block = addr >> this->blockoffset_size;
+   uint32_t lru = this->prefetch_Unit->N - 1;
+   streamBuffer& buffer = this->prefetch_Unit->streamBuffers[lru];
 
-   // set as most recently used
-   streamBuffer->lruStreamBuffer = this->prefetch_Unit->N - 1;
+   this->prefetchBlocks(block + 1, block + this->prefetch_Unit->M);
+   buffer.head = block + 1;
+   buffer.count = this->prefetch_Unit->M;
 
-   return;
+   // set as most recently used
+   this->prefetch_Unit->touch(lru);
 }
 
-// Update stream buffer
-void cache::updateStreamBuffer(uint32_t addr, streamBuffer* streamBuffer){
+// Update stream buffer after a hit: drop every block up to and including addr's
+// block, then prefetch past the old tail so the buffer holds M blocks again
+void cache::updateStreamBuffer(uint32_t addr, uint32_t index){
+   uint32_t block = addr >> this->blockoffset_size;
+   streamBuffer& buffer = this->prefetch_Unit->streamBuffers[index];
 
-   bool prefetch_from_lower_cache = false;
+   this->prefetchBlocks(buffer.head + buffer.count, block + this->prefetch_Unit->M);
+   buffer.head = block + 1;
+   buffer.count = this->prefetch_Unit->M;
 
-   // Check if prefetch unit is not the lowest cache level
-   if(this->level_below != NULL){
-      std::cout << "Prefetching from lower cache" << std::endl;
-      prefetch_from_lower_cache = true;
-   } 
-
-   uint32_t startAddr = addr;
+   // set as most recently used
+   this->prefetch_Unit->touch(index);
+}
 
-   // Check if stream buffer is valid
-   if(streamBuffer->valid){
-      // Address to start iterating from is the last address in the stream buffer
-      startAddr = streamBuffer->streamQueue.back().address;
+// Feedback and training for the engines that prefetch into the cache. A demand
+// hit on a prefetched block makes the prefetch useful (and late if it had not
+// arrived yet); a demand miss on a block that a prefetch fill evicted makes that
+// prefetch polluting.
+void cache::prefetch_demand(uint32_t set, uint32_t way, uint32_t addr, bool hit){
+   uint32_t block = addr >> this->blockoffset_size;
+   if (hit) {
+      if (!this->is_prefetched(set, way)) { return; }
+      this->set_prefetched(set, way, false);
+      this->prefetches_useful++;
+      if (this->reads + this->writes < this->prefetch_ready[this->slot(set, way)]) { this->prefetches_late++; }
    } else {
-      // Address to start iterating from is the address that is being requested
-      startAddr = addr;
-      // Create temp address
-      startAddr = startAddr >> this->blockoffset_size;
-   }
-
-   // Calculate how many blocks are in the stream buffer
-   uint32_t blocksInStreamBuffer = streamBuffer->streamQueue.size();
-   // Calculate how many blocks need to be added
-   uint32_t blocksToAdd = this->prefetch_Unit->M - blocksInStreamBuffer;
-
-   // Fill the stream buffer with new blocks starting from addr to addr + M - 1
-   for (int i = 0; i < (int)blocksToAdd; i++) {
-
-      // check if the stream buffer is over the max size
-      if(this->prefetch_Unit->M <= (int)streamBuffer->streamQueue.size()){
-         //std::cout << "Stream buffer is over the max size" << std::endl;
-         break;
+      uint32_t& evicted = this->pollution_filter[block % POLLUTION_FILTER_SIZE];
+      if (evicted == block + 1) {
+         this->prefetches_polluting++;
+         evicted = 0;
       }
+   }
 
-      // Increment prefetches
-      this->prefetches++;
-
-      uint32_t newAddress = startAddr + i + 1;
-      streamBuffer->streamQueue.push_back(newAddress);
-
-      if(prefetch_from_lower_cache){
-         // Send prefetch request to lower cache
-         this->level_below->request(newAddress, 'r');
-      } else {
-         // Send prefetch request to memory
-         this->memory_traffic++;
-      }
-   } 
-   // Set valid bit
-   streamBuffer->valid = true;
+   this->prefetch_candidates.clear();
+   this->prefetch_engine->train(block, this->prefetch_candidates);
+   for (size_t i = 0; i < this->prefetch_candidates.size(); i++) {
+      this->prefetch_into_cache(this->prefetch_candidates[i]);
+   }
+}
 
-   // check all other stream buffers and decrement the ones that at greater than the current lruStreamCounter
-   for(int i = 0; i < this->prefetch_Unit->N; i++){
-      if(this->prefetch_Unit->streamBuffers[i].lruStreamBuffer > streamBuffer->lruStreamBuffer){
-         this->prefetch_Unit->streamBuffers[i].lruStreamBuffer--;
-      }
+// Fetch a block into the cache ahead of demand, unless it is already there
+void cache::prefetch_into_cache(uint32_t block){
+   if (block > (0xFFFFFFFFu >> this->blockoffset_size)) { return; }     // Past the end of the address space
+   uint32_t addr = block << this->blockoffset_size;
+   uint32_t set = this->parse_index(addr);
+   uint32_t way;
+   if (this->lookup(set, this->parse_tag(addr), way)) { return; }
+
+   if (this->is_valid(set, way)) {
+      uint32_t victim = this->block_address(set, way) >> this->blockoffset_size;
+      this->pollution_filter[victim % POLLUTION_FILTER_SIZE] = victim + 1;
    }
+   this->writeback_logic(set, way);
 
-   // set as most recently used
-   streamBuffer->lruStreamBuffer = this->prefetch_Unit->N - 1;
+   this->prefetches++;
+   TRACE_EVENT(EV_PREFETCH, this->level, set, way, addr);
+   if (this->timing != NULL) { this->timing->on_prefetch(this, block); }
+   if (this->level_below != NULL) {
+      this->send_below(addr, 'p');
+   } else {
+      this->memory_traffic++;
+   }
 
-   return;
+   this->install_block(set, way, addr, 'r');
+   this->set_prefetched(set, way, true);
+   this->prefetch_ready[this->slot(set, way)] = this->reads + this->writes + PREFETCH_LATENCY;
 }
 
 void cache::printStreamBuffer(){
     std::cout << "===== Stream Buffer(s) contents =====" << std::endl;
 
-    // Create a vector to hold the stream buffers in MRU to LRU order
-    std::vector<std::vector<uint32_t> > orderedStreamBuffers(this->prefetch_Unit->N);
-
-    // Map lruStreamBuffer values to indices (N-1 = MRU, 0 = LRU for lruStreamBuffer)
+    // Print the stream buffers from MRU to LRU; empty buffers print as blank lines
     for(int i = 0; i < this->prefetch_Unit->N; i++){
-        // Find the stream buffer with lruStreamBuffer == i
-        for(int j = 0; j < this->prefetch_Unit->N; j++){
-            if(this->prefetch_Unit->streamBuffers[j].lruStreamBuffer == this->prefetch_Unit->N - i - 1){
-                // If the stream buffer is valid
-                if(this->prefetch_Unit->streamBuffers[j].valid){
-                    // Copy the addresses into the ordered list
-                    std::vector<uint32_t> buffer_contents;
-                    for(const auto& block : this->prefetch_Unit->streamBuffers[j].streamQueue){
-                        buffer_contents.push_back(block.address);
-                    }
-                    orderedStreamBuffers[i] = buffer_contents;
-                } else {
-                    // If invalid, store an empty vector
-                    orderedStreamBuffers[i] = std::vector<uint32_t>();
-                }
-                break;
-            }
-        }
-    }
-
-    // Print the stream buffers from MRU to LRU
-    for(int i = 0; i < this->prefetch_Unit->N; i++){
-        // Print each address in the stream buffer
-        for(const auto& addr : orderedStreamBuffers[i]){
-            std::cout << std::hex << addr << " ";
+        const streamBuffer& buffer = this->prefetch_Unit->streamBuffers[i];
+        for(uint32_t k = 0; k < buffer.count; k++){
+            std::cout << std::hex << buffer.head + k << " ";
         }
         std::cout << std::dec << std::endl;
     }
@@ -504,110 +994,68 @@ void cache::printStreamBuffer(){
 
 
 // Deal with parsed instruction/address
-void cache::request(uint32_t addr, char rw){
+template<class Geometry>
+void cache::request_impl(uint32_t addr, char rw){
    // Flags and indexes
-   uint32_t LRUmax = this->cache_array[this->parse_index(addr)].LRU_max;
-   uint32_t addr_tag = this->parse_tag(addr);
+   uint32_t set = Geometry::index(*this, addr);
+   uint32_t addr_tag = Geometry::tag(*this, addr);
 
+   // 'p' is a prefetch from the level above: a read counted apart from the demand reads
    if (rw == 'r'){ this->reads++; }
+   else if (rw == 'p'){ this->reads_prefetch++; }
    else { this->writes++; }
 
-   // Get pointer to the cache set the address indexes
-   std::vector<cache_block> *setptr = this->cache_array[this->parse_index(addr)].getCacheSet();
-
    bool hit = false;
-   int hit_index = 0;
-   uint32_t LRU_index = 0;      // Tracks the highest LRU counter index relative to the current set
-   uint32_t invalid_index = 0;  // Index of invalid block, if any blocks are invalid
-   bool invalid = false;         // Tracks if any invalid blocks exist in the current set
+   uint32_t hit_index = 0;      // Hit way, or the way to replace on a miss
 
-   // Stream buffer logic
+   // Stream buffer logic (the other prefetch engines fill the cache instead, see prefetch_demand())
+   bool streams = this->prefetch_enabled && this->prefetch_engine == NULL;
    bool stream_hit = false;
-   uint32_t stream_hit_index = -1;
-   int tempSizeOfPrefetchUnit = 1;
-
-   // make sure prefetch unit is ena
-   if(prefetch_enabled){
-      tempSizeOfPrefetchUnit = this->prefetch_Unit->N;
-   }
-
-   // initialize order of use array
-   streamBuffer* order_of_use[tempSizeOfPrefetchUnit];
-
+   uint32_t stream_hit_index = 0;
 
-   if(this->prefetch_enabled){
-      // Initialize order of use array
-      for(int i = 0; i < this->prefetch_Unit->N; i++){
-         order_of_use[this->prefetch_Unit->streamBuffers[i].lruStreamBuffer] = &this->prefetch_Unit->streamBuffers[i];   // Set the index of the stream buffer in the order of use
-      }
-
-      // Check all stream buffers in order of least recently used to most recently used for a hit
-      for(int i = this->prefetch_Unit->N - 1; i >= 0; i--){
-         if(order_of_use[i]->valid) { 
-            stream_hit = this->searchStreamBuffer(addr, order_of_use[i]); 
-            if(stream_hit){
-               stream_hit_index = i;
-               break;
-            }
-         } 
-      }
-
-   } else {                // Invalid stream buffer or prefetch disabled
-      stream_hit = false;
-      stream_hit_index = -1;     // Set to -1 to indicate no stream buffer hit
+   if(streams){
+      stream_hit = this->searchStreamBuffer(addr, stream_hit_index);
    }
 
+   // Compare the tag against every way in the indexed set
+   hit = Geometry::lookup(*this, set, addr_tag, hit_index);
 
-   // Loop through all blocks in indexed set and determine if the trace Hits
-   for(int i = 0; i < (int)setptr->size(); i++){
-      uint32_t set_tag = (*setptr)[i].tag;
-
-      // Check LRU and Valid flags
-      if ((*setptr)[i].valid == false && invalid == false){ invalid = true; invalid_index = i; }     // Find first invalid block that exists
-      if ((*setptr)[i].LRUCounter == LRUmax){ LRU_index = i; }       // Find max LRU block
-      
-      // Check if block is in current set
-      if (set_tag == addr_tag && (*setptr)[i].valid){
-         // std::cout << this->cache_name << " - Cache HIT " << "\n" << std::endl;
-         hit = true;
-         hit_index = i;
+   if (hit) { TRACE_EVENT(EV_HIT, this->level, set, hit_index, addr); }
+   else { TRACE_EVENT(EV_MISS, this->level, set, hit_index, addr); }
 
-         // If stream buffer hits
-         if(stream_hit && this->prefetch_enabled){   // -- Scenario #4 Cache hit & Stream buffer hit
-            // Update stream buffer
-            this->updateStreamBuffer(addr, order_of_use[stream_hit_index]);   // Update the stream buffer that was hit
-         } // -- Scenario #3 Cache hit & Stream buffer miss
+   // If stream buffer hits
+   if(hit && stream_hit && streams){   // -- Scenario #4 Cache hit & Stream buffer hit
+      // Update stream buffer
+      this->updateStreamBuffer(addr, stream_hit_index);   // Update the stream buffer that was hit
+   } // -- Scenario #3 Cache hit & Stream buffer miss
 
-         break;
-      }
-   }
    // HIT
    if(hit){
       // If write, set dirty bit
       if (rw == 'w'){
-         (*setptr)[hit_index].dirty = true;
-         //(*setptr)[i].data = addr;
+         this->set_dirty(set, hit_index, true);
       }
-      (*setptr)[hit_index].valid = true;                   // Mark block as valid
-      this->update_lru((*setptr)[hit_index].LRUCounter, addr, setptr, hit_index);      // Update LRU
+      this->policy->on_hit(set, hit_index);      // Update replacement state
+      if (this->prefetch_engine != NULL && rw != 'p') { this->prefetch_demand(set, hit_index, addr, true); }
    
    // CACHE MISS
    } else {
       // If stream buffer miss also    -- Scenario #1 Cache miss & Stream buffer miss
-      if(!stream_hit && this->prefetch_enabled){
+      if(!stream_hit && streams){
          // Initialize steam buffer with next address
-         this->initializeStreamBuffer(addr, order_of_use[0]);     // Initialize the least recently used stream buffer
+         this->initializeStreamBuffer(addr);     // Initialize the least recently used stream buffer
          // Increment prefetches
-      } else if(stream_hit && this->prefetch_enabled){   // Scenario #2 Cache miss & Stream buffer hit
+      } else if(stream_hit && streams){   // Scenario #2 Cache miss & Stream buffer hit
          // If stream buffer hit
-         this->updateStreamBuffer(addr, order_of_use[stream_hit_index]);
+         this->prefetches_useful++;
+         this->updateStreamBuffer(addr, stream_hit_index);
       }
 
-      // Get eviction index
-      uint32_t replace_index = invalid ? invalid_index : LRU_index;
+      // Eviction index from lookup(): first invalid way, else the policy's victim
+      uint32_t replace_index = hit_index;
 
       // Writeback before read from higher level
-      writeback_logic(addr, replace_index, setptr);
+      writeback_logic(set, replace_index);
 
       if(rw == 'w'){ // Write MISS
 
@@ -617,7 +1065,7 @@ void cache::request(uint32_t addr, char rw){
 
             // Fetch block from next level (memory)
             if (this->level_below != NULL) { // If this is the last-level cache
-               level_below->request(addr, 'r');
+               this->send_below(addr, 'r');
             } else {
 
                memory_traffic++;
@@ -625,23 +1073,56 @@ void cache::request(uint32_t addr, char rw){
             }
          }
          
-         install_block(replace_index, addr, setptr, 'w');
+         install_block(set, replace_index, addr, 'w');
 
       } else {    // Read MISS
 
          // Check if stream buffer hit or missed
          if(!stream_hit){
-            read_miss_count++;   // Only increment read miss count if stream buffer miss
+            // Only increment read miss count if stream buffer miss
+            if (rw == 'p') { read_miss_prefetch++; }
+            else { read_miss_count++; }
             // Fetch block from next level (memory)
             if (level_below != NULL) {
-               this->level_below->request(addr, 'r');    // Read & Write requests both get send to lower level as read
+               this->send_below(addr, rw == 'p' ? 'p' : 'r');    // Read & Write requests both get send to lower level as read
             } else {
 
                memory_traffic++;
             }
          }
 
-         install_block(replace_index, addr, setptr, 'r');
+         install_block(set, replace_index, addr, 'r');
       }
+
+      if (this->prefetch_engine != NULL && rw != 'p') { this->prefetch_demand(set, replace_index, addr, false); }
    }
 }
+
+// Geometries compiled as fixed_geometry<> instantiations: the block sizes, set
+// counts and associativities the experiment scripts and val-proj1 runs use
+#define FIXED_GEOMETRY(BS, SETS, ASSOC) \
+   if (this->blocksize == BS && this->num_sets == SETS && this->assoc == ASSOC) { \
+      this->request_fn = &cache::request_impl<fixed_geometry<BS, SETS, ASSOC> >; \
+      this->unrolled_lookup = !fixed_geometry<BS, SETS, ASSOC>::uses_kernel; \
+      return; \
+   }
+#define FIXED_ASSOCS(BS, SETS) \
+   FIXED_GEOMETRY(BS, SETS, 1) FIXED_GEOMETRY(BS, SETS, 2) FIXED_GEOMETRY(BS, SETS, 4) \
+   FIXED_GEOMETRY(BS, SETS, 8) FIXED_GEOMETRY(BS, SETS, 16)
+#define FIXED_GEOMETRIES(BS) \
+   FIXED_ASSOCS(BS, 16) FIXED_ASSOCS(BS, 32) FIXED_ASSOCS(BS, 64) FIXED_ASSOCS(BS, 128) \
+   FIXED_ASSOCS(BS, 256) FIXED_ASSOCS(BS, 512) FIXED_ASSOCS(BS, 1024) FIXED_ASSOCS(BS, 2048)
+
+void cache::select_engine(){
+   FIXED_GEOMETRIES(16)
+   FIXED_GEOMETRIES(32)
+   FIXED_GEOMETRIES(64)
+   FIXED_GEOMETRIES(128)
+
+   this->request_fn = &cache::request_impl<runtime_geometry>;
+   this->unrolled_lookup = false;
+}
+
+const char* cache::tag_compare_name() const {
+   return this->unrolled_lookup ? "unrolled" : way_match_name(this->match_ways);
+}
@@ -0,0 +1,222 @@
+// Benchmark: cache_hierarchy::request_batch throughput over a fixed configuration matrix
+//
+//    ./sim_bench [--baseline FILE] [--save FILE] [--tolerance PCT] [--reps N] [trace_file ...]
+//
+// Traces default to ../test/traces/*.txt. Each trace is decoded into memory once.
+// Every configuration then runs in a forked child, so the peak RSS reported is that
+// run's own; the child replays the trace on a fresh hierarchy N times (default
+// BENCH_REPS) and reports the median pass.
+//
+// Output is one CSV row per configuration and trace. Only with --baseline are the rows
+// compared: one whose ns per access is more than PCT percent (default BENCH_TOLERANCE,
+// above the run-to-run spread of the median) over the baseline's is "slower" and fails
+// the run; "faster" rows beat it by as much. Baselines are only comparable on the
+// machine they were saved on: --save writes this run's rows as a new baseline.
+// ../test/bench/example_baseline.csv shows the format; its numbers are from one VM.
+// Each configuration's tag compare per level (see Geometry.h) is noted on stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <string>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Trace.h"
+
+#define BENCH_REPS        11
+#define BENCH_TOLERANCE   20.0
+
+// Direct-mapped to 16-way L1, with and without an L2, with and without prefetching
+static void bench_configs(std::vector<cache_params_t>& configs){
+   static const uint32_t assocs[] = { 1, 2, 4, 8, 16 };
+   for (int l2 = 0; l2 < 2; l2++) {
+      for (int pref = 0; pref < 2; pref++) {
+         for (size_t a = 0; a < sizeof(assocs) / sizeof(assocs[0]); a++) {
+            cache_params_t params;
+            params.BLOCKSIZE  = 32;
+            params.L1_SIZE    = 16384;
+            params.L1_ASSOC   = assocs[a];
+            params.L2_SIZE    = l2 ? 262144 : 0;
+            params.L2_ASSOC   = l2 ? 8 : 0;
+            params.PREF_N     = pref ? 4 : 0;
+            params.PREF_M     = pref ? 8 : 0;
+            params.L1_POLICY  = REPL_LRU;
+            params.L2_POLICY  = REPL_LRU;
+            params.PREFETCHER = PREF_STREAM;
+            configs.push_back(params);
+         }
+      }
+   }
+}
+
+static std::string config_name(const cache_params_t& p){
+   char name[96];
+   snprintf(name, sizeof(name), "%u_%u_%u_%u_%u_%u_%u", p.BLOCKSIZE, p.L1_SIZE, p.L1_ASSOC, p.L2_SIZE, p.L2_ASSOC, p.PREF_N, p.PREF_M);
+   return std::string(name);
+}
+
+// Median seconds for one pass over the trace; unlike the best pass, one lucky or
+// preempted rep does not move it
+static double time_config(const cache_params_t& params, const std::vector<trace_request_t>& trace, int reps){
+   std::vector<double> passes;
+   for (int rep = 0; rep < reps; rep++) {
+      cache_hierarchy hierarchy(params);
+      auto start = std::chrono::steady_clock::now();
+      hierarchy.request_batch(trace.data(), trace.size());
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      passes.push_back(elapsed.count());
+   }
+   std::sort(passes.begin(), passes.end());
+   return (reps % 2) ? passes[reps / 2] : (passes[reps / 2 - 1] + passes[reps / 2]) / 2;
+}
+
+// Run time_config in a child; returns false if it failed. rss_kb is the child's peak RSS.
+static bool run_child(const cache_params_t& params, const std::vector<trace_request_t>& trace, int reps,
+                      double& seconds, long& rss_kb){
+   int fds[2];
+   if (pipe(fds) != 0) { return false; }
+   fflush(stdout);
+   pid_t pid = fork();
+   if (pid < 0) { return false; }
+   if (pid == 0) {
+      close(fds[0]);
+      double best = time_config(params, trace, reps);
+      _exit(write(fds[1], &best, sizeof(best)) == sizeof(best) ? 0 : 1);
+   }
+   close(fds[1]);
+   bool ok = read(fds[0], &seconds, sizeof(seconds)) == sizeof(seconds);
+   close(fds[0]);
+   int status;
+   struct rusage usage;
+   if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) { ok = false; }
+   rss_kb = usage.ru_maxrss;
+   return ok;
+}
+
+// Baseline rows keyed by "config,trace"; the ns per access is the fifth field
+static bool load_baseline(const char *file, std::map<std::string, double>& baseline){
+   FILE *fp = fopen(file, "r");
+   if (fp == (FILE *) NULL) { return false; }
+   char line[512];
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      std::vector<std::string> fields;
+      char *save = NULL;
+      for (char *field = strtok_r(line, ",\n", &save); field != NULL; field = strtok_r(NULL, ",\n", &save)) {
+         fields.push_back(field);
+      }
+      if (fields.size() < 5 || fields[0] == "config") { continue; }
+      baseline[fields[0] + "," + fields[1]] = atof(fields[4].c_str());
+   }
+   fclose(fp);
+   return true;
+}
+
+int main(int argc, char *argv[]){
+   const char *baseline_file = NULL;
+   const char *save_file = NULL;
+   double tolerance = BENCH_TOLERANCE;
+   int reps = BENCH_REPS;
+   std::vector<std::string> files;
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) { baseline_file = argv[++i]; }
+      else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) { save_file = argv[++i]; }
+      else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) { tolerance = atof(argv[++i]); }
+      else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) { reps = atoi(argv[++i]); }
+      else if (strncmp(argv[i], "--", 2) == 0) {
+         printf("Error: unknown option %s\n", argv[i]);
+         exit(EXIT_FAILURE);
+      }
+      else { files.push_back(argv[i]); }
+   }
+   if (files.empty()) {
+      glob_t g;
+      if (glob("../test/traces/*.txt", 0, NULL, &g) == 0) {
+         for (size_t i = 0; i < g.gl_pathc; i++) {
+            files.push_back(g.gl_pathv[i]);
+         }
+      }
+      globfree(&g);
+   }
+
+   std::map<std::string, double> baseline;
+   if (baseline_file != NULL && !load_baseline(baseline_file, baseline)) {
+      printf("Error: Unable to open file %s\n", baseline_file);
+      exit(EXIT_FAILURE);
+   }
+   if (baseline_file != NULL) { fprintf(stderr, "Comparing against %s, tolerance %.1f%%\n", baseline_file, tolerance); }
+
+   FILE *save = NULL;
+   if (save_file != NULL && (save = fopen(save_file, "w")) == (FILE *) NULL) {
+      printf("Error: Unable to open file %s\n", save_file);
+      exit(EXIT_FAILURE);
+   }
+
+   std::vector<cache_params_t> configs;
+   bench_configs(configs);
+   for (size_t c = 0; c < configs.size(); c++) {
+      cache_hierarchy hierarchy(configs[c]);
+      fprintf(stderr, "%s tag compare:", config_name(configs[c]).c_str());
+      for (size_t level = 0; level < hierarchy.levels.size(); level++) {
+         fprintf(stderr, " %s %s", hierarchy.levels[level]->cache_name.c_str(), hierarchy.levels[level]->tag_compare_name());
+      }
+      fprintf(stderr, "\n");
+   }
+
+   int failures = 0, regressions = 0;
+   const char *header = "config,trace,accesses,accesses_per_sec,ns_per_access,peak_rss_kb";
+   printf("%s,baseline_ns_per_access,change_pct,status\n", header);
+   if (save != NULL) { fprintf(save, "%s\n", header); }
+   for (size_t f = 0; f < files.size(); f++) {
+      std::vector<trace_request_t> trace;
+      if (!load_trace(files[f].c_str(), trace)) {
+         failures++;
+         continue;
+      }
+      std::string trace_name = files[f].substr(files[f].find_last_of('/') + 1);
+
+      for (size_t c = 0; c < configs.size(); c++) {
+         std::string name = config_name(configs[c]);
+         double seconds;
+         long rss_kb;
+         if (!run_child(configs[c], trace, reps, seconds, rss_kb)) {
+            printf("Error: %s on %s did not finish\n", name.c_str(), trace_name.c_str());
+            failures++;
+            continue;
+         }
+
+         double ns = 1e9 * seconds / trace.size();
+         char row[256];
+         snprintf(row, sizeof(row), "%s,%s,%zu,%.0f,%.3f,%ld", name.c_str(), trace_name.c_str(), trace.size(),
+                  trace.size() / seconds, ns, rss_kb);
+         if (save != NULL) { fprintf(save, "%s\n", row); }
+
+         std::map<std::string, double>::iterator base = baseline.find(name + "," + trace_name);
+         if (base == baseline.end()) {
+            printf("%s,,,new\n", row);
+            continue;
+         }
+         double change = 100.0 * (ns - base->second) / base->second;
+         const char *status = "ok";
+         if (change > tolerance) { status = "slower"; regressions++; }
+         else if (change < -tolerance) { status = "faster"; }
+         printf("%s,%.3f,%.1f,%s\n", row, base->second, change, status);
+      }
+   }
+
+   if (save != NULL && fclose(save) != 0) {
+      printf("Error: Unable to write %s\n", save_file);
+      failures++;
+   }
+   if (regressions != 0) { fprintf(stderr, "%d configuration(s) slower than the baseline\n", regressions); }
+   return (failures == 0 && regressions == 0) ? 0 : 1;
+}
@@ -0,0 +1,319 @@
+// Randomized differential test: the simulator's caches against a slow reference model
+//
+//    ./sim_check [--seed S] [--runs N] [--length L]
+//
+// Each run draws a classic configuration (LRU, stream buffers on the last level, block
+// sizes, associativities and set counts varied) and a synthetic trace mixing sequential
+// streams, strides, a hot working set and random addresses. The trace is replayed on
+// cache_hierarchy and on ref_cache, a direct transcription of the project spec: sets
+// are MRU-ordered lists and stream buffers hold their block numbers explicitly. Every
+// counter is compared after every request and the set contents at the end; the first
+// difference is reported with the seed that reproduces it. The trace is then replayed
+// once more through request_batch(), whose end state must match too.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <list>
+#include <deque>
+#include <vector>
+#include <string>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Trace.h"
+
+#define CHECK_SEED     1
+#define CHECK_RUNS     300
+#define CHECK_LENGTH   20000
+
+// ------------ Class: ref_cache ------------ //
+typedef
+struct {
+   uint32_t block;      // Address >> block offset bits
+   bool dirty;
+} ref_block_t;
+
+class ref_cache{
+    public:
+    uint32_t blocksize;
+    uint32_t num_sets;
+    uint32_t assoc;
+    std::vector<std::list<ref_block_t> > sets;          // Front is MRU
+    uint32_t N;
+    uint32_t M;
+    std::list<std::deque<uint32_t> > buffers;          // Front is MRU; an empty deque is an invalid buffer
+    ref_cache *below;
+
+    uint64_t reads, writes, read_misses, write_misses, reads_prefetch, read_misses_prefetch;
+    uint64_t writebacks, prefetches, prefetches_useful, memory_traffic;
+
+    ref_cache(uint32_t blocksize, uint32_t size, uint32_t assoc, uint32_t N, uint32_t M, ref_cache *below)
+       : blocksize(blocksize), num_sets(size / (assoc * blocksize)), assoc(assoc), N(N), M(M), below(below),
+         reads(0), writes(0), read_misses(0), write_misses(0), reads_prefetch(0), read_misses_prefetch(0),
+         writebacks(0), prefetches(0), prefetches_useful(0), memory_traffic(0) {
+       this->sets.resize(this->num_sets);
+       this->buffers.resize(N);
+    }
+
+    void fetch(uint32_t block, char rw){
+       if (this->below != NULL) { this->below->request(block * this->blocksize, rw); }
+       else { this->memory_traffic++; }
+    }
+
+    // Prefetch the blocks after the buffer's last up to block + M, then hold block + 1 ... block + M
+    void refill(std::deque<uint32_t>& buffer, uint32_t block){
+       uint32_t first = buffer.empty() ? block + 1 : buffer.back() + 1;
+       for (uint32_t b = first; b <= block + this->M; b++) {
+          this->prefetches++;
+          this->fetch(b, 'p');
+       }
+       buffer.clear();
+       for (uint32_t b = block + 1; b <= block + this->M; b++) { buffer.push_back(b); }
+    }
+
+    void request(uint32_t addr, char rw){
+       uint32_t block = addr / this->blocksize;
+       std::list<ref_block_t>& set = this->sets[block % this->num_sets];
+       if (rw == 'r') { this->reads++; }
+       else if (rw == 'p') { this->reads_prefetch++; }
+       else { this->writes++; }
+
+       std::list<std::deque<uint32_t> >::iterator buffer = this->buffers.begin();
+       for (; buffer != this->buffers.end(); ++buffer) {
+          bool held = false;
+          for (size_t i = 0; i < buffer->size(); i++) { held = held || (*buffer)[i] == block; }
+          if (held) { break; }
+       }
+       bool stream_hit = (buffer != this->buffers.end());
+
+       std::list<ref_block_t>::iterator hit = set.begin();
+       while (hit != set.end() && hit->block != block) { ++hit; }
+
+       // Stream buffers: a hit moves the buffer past the block, a demand miss claims the LRU buffer
+       if (this->N != 0) {
+          if (stream_hit) {
+             if (hit == set.end()) { this->prefetches_useful++; }
+             this->buffers.splice(this->buffers.begin(), this->buffers, buffer);
+             this->refill(this->buffers.front(), block);
+          } else if (hit == set.end()) {
+             this->buffers.splice(this->buffers.begin(), this->buffers, --this->buffers.end());
+             this->buffers.front().clear();
+             this->refill(this->buffers.front(), block);
+          }
+       }
+
+       if (hit != set.end()) {
+          ref_block_t b = *hit;
+          b.dirty = b.dirty || rw == 'w';
+          set.erase(hit);
+          set.push_front(b);
+          return;
+       }
+
+       if (set.size() == this->assoc) {
+          if (set.back().dirty) {
+             this->writebacks++;
+             this->fetch(set.back().block, 'w');
+          }
+          set.pop_back();
+       }
+       if (!stream_hit) {
+          if (rw == 'w') { this->write_misses++; }
+          else if (rw == 'p') { this->read_misses_prefetch++; }
+          else { this->read_misses++; }
+          this->fetch(block, rw == 'p' ? 'p' : 'r');
+       }
+       ref_block_t b = { block, rw == 'w' };
+       set.push_front(b);
+    }
+};
+
+// ------------ Random configurations and traces ------------ //
+static uint64_t rng_state;
+
+static uint32_t rng(){
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 7;
+   rng_state ^= rng_state << 17;
+   return (uint32_t) (rng_state >> 32);
+}
+
+static uint32_t pick(const uint32_t *values, uint32_t count){ return values[rng() % count]; }
+
+static cache_params_t random_config(){
+   static const uint32_t blocksizes[] = { 16, 32, 64 };
+   static const uint32_t assocs[] = { 1, 2, 3, 4, 6, 8, 16 };
+   static const uint32_t set_counts[] = { 1, 2, 8, 32, 64, 256 };
+   cache_params_t params;
+   params.BLOCKSIZE = pick(blocksizes, 3);
+   params.L1_ASSOC  = pick(assocs, 7);
+   params.L1_SIZE   = params.BLOCKSIZE * params.L1_ASSOC * pick(set_counts, 6);
+   params.L2_SIZE   = 0;
+   params.L2_ASSOC  = 0;
+   if (rng() % 2) {
+      params.L2_ASSOC = pick(assocs, 7);
+      params.L2_SIZE  = params.BLOCKSIZE * params.L2_ASSOC * pick(set_counts, 6) * 4;
+   }
+   params.PREF_N = 0;
+   params.PREF_M = 0;
+   if (rng() % 2) {
+      params.PREF_N = 1 + rng() % 8;
+      params.PREF_M = 1 + rng() % 8;
+   }
+   params.L1_POLICY  = REPL_LRU;
+   params.L2_POLICY  = REPL_LRU;
+   params.PREFETCHER = PREF_STREAM;
+   return params;
+}
+
+// Phases of sequential, strided, hot-set and random requests
+static void random_trace(std::vector<trace_request_t>& trace, uint32_t length){
+   trace.clear();
+   uint32_t base = rng() & 0xFFFFF000;
+   while (trace.size() < length) {
+      uint32_t kind = rng() % 4;
+      uint32_t run = 50 + rng() % 500;
+      uint32_t addr = base + (rng() % 65536);
+      uint32_t stride = (kind == 1) ? 4 << (rng() % 8) : 4;
+      uint32_t hot_size = 256 << (rng() % 6);
+      for (uint32_t i = 0; i < run && trace.size() < length; i++) {
+         trace_request_t request;
+         if (kind == 0 || kind == 1) { request.addr = addr + i * stride; }
+         else if (kind == 2) { request.addr = base + rng() % hot_size; }
+         else { request.addr = rng(); }
+         request.rw = (rng() % 4 == 0) ? 'w' : 'r';
+         trace.push_back(request);
+      }
+   }
+}
+
+// ------------ Comparison ------------ //
+static std::string config_string(const cache_params_t& p){
+   char s[96];
+   snprintf(s, sizeof(s), "%u %u %u %u %u %u %u", p.BLOCKSIZE, p.L1_SIZE, p.L1_ASSOC, p.L2_SIZE, p.L2_ASSOC, p.PREF_N, p.PREF_M);
+   return std::string(s);
+}
+
+// Name of the first counter that differs, NULL if all match
+static const char *compare_counters(const cache *c, const ref_cache *r, uint64_t& engine, uint64_t& reference){
+   struct { const char *name; uint64_t engine; uint64_t reference; } counters[] = {
+      { "reads",                  c->reads,              r->reads },
+      { "read misses",            c->read_miss_count,    r->read_misses },
+      { "writes",                 c->writes,             r->writes },
+      { "write misses",           c->write_miss_count,   r->write_misses },
+      { "reads (prefetch)",       c->reads_prefetch,     r->reads_prefetch },
+      { "read misses (prefetch)", c->read_miss_prefetch, r->read_misses_prefetch },
+      { "writebacks",             c->writeback,          r->writebacks },
+      { "prefetches",             c->prefetches,         r->prefetches },
+      { "useful prefetches",      c->prefetches_useful,  r->prefetches_useful },
+      { "memory traffic",         c->memory_traffic,     r->memory_traffic },
+   };
+   for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+      if (counters[i].engine != counters[i].reference) {
+         engine = counters[i].engine;
+         reference = counters[i].reference;
+         return counters[i].name;
+      }
+   }
+   return NULL;
+}
+
+// First set whose blocks (MRU to LRU, with dirty bits) differ, -1 if none
+static int64_t compare_contents(cache *c, const ref_cache *r){
+   std::vector<uint32_t> ways;
+   for (uint32_t set = 0; set < c->num_sets; set++) {
+      c->policy->order(set, ways);
+      std::list<ref_block_t>::const_iterator b = r->sets[set].begin();
+      for (size_t k = 0; k < ways.size(); k++) {
+         if (!c->is_valid(set, ways[k])) { continue; }
+         if (b == r->sets[set].end() || (b->block >> c->index_bit_size) != c->tags[c->slot(set, ways[k])] ||
+             b->dirty != c->is_dirty(set, ways[k])) { return set; }
+         ++b;
+      }
+      if (b != r->sets[set].end()) { return set; }
+   }
+   return -1;
+}
+
+// One configuration over one trace; prints the first difference and returns false
+static bool check_run(uint64_t seed, const cache_params_t& params, const std::vector<trace_request_t>& trace){
+   cache_hierarchy hierarchy(params);
+   bool l2 = params.L2_SIZE != 0;
+   ref_cache ref_l2(params.BLOCKSIZE, l2 ? params.L2_SIZE : params.BLOCKSIZE, l2 ? params.L2_ASSOC : 1,
+                    params.PREF_M ? params.PREF_N : 0, params.PREF_N ? params.PREF_M : 0, NULL);
+   ref_cache ref_l1(params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC,
+                    (!l2 && params.PREF_M) ? params.PREF_N : 0, (!l2 && params.PREF_N) ? params.PREF_M : 0, l2 ? &ref_l2 : NULL);
+   const ref_cache *refs[2] = { &ref_l1, &ref_l2 };
+
+   for (size_t i = 0; i < trace.size(); i++) {
+      hierarchy.request(trace[i].addr, trace[i].rw);
+      ref_l1.request(trace[i].addr, trace[i].rw);
+      for (size_t level = 0; level < hierarchy.levels.size(); level++) {
+         uint64_t engine, reference;
+         const char *counter = compare_counters(hierarchy.levels[level], refs[level], engine, reference);
+         if (counter != NULL) {
+            printf("FAIL seed %" PRIu64 ", config %s: after request %zu (%c %x), %s %s is %" PRIu64 ", reference %" PRIu64 "\n",
+                   seed, config_string(params).c_str(), i, trace[i].rw, trace[i].addr,
+                   hierarchy.levels[level]->cache_name.c_str(), counter, engine, reference);
+            return false;
+         }
+      }
+   }
+   for (size_t level = 0; level < hierarchy.levels.size(); level++) {
+      int64_t set = compare_contents(hierarchy.levels[level], refs[level]);
+      if (set >= 0) {
+         printf("FAIL seed %" PRIu64 ", config %s: %s set %" PRId64 " holds different blocks at the end\n",
+                seed, config_string(params).c_str(), hierarchy.levels[level]->cache_name.c_str(), set);
+         return false;
+      }
+   }
+
+   // The batched path (cache_hierarchy::request_batch) must end in the same state
+   cache_hierarchy batched(params);
+   batched.request_batch(trace.data(), trace.size());
+   for (size_t level = 0; level < batched.levels.size(); level++) {
+      uint64_t engine, reference;
+      const char *counter = compare_counters(batched.levels[level], refs[level], engine, reference);
+      if (counter != NULL) {
+         printf("FAIL seed %" PRIu64 ", config %s: batched, %s %s is %" PRIu64 ", reference %" PRIu64 "\n",
+                seed, config_string(params).c_str(), batched.levels[level]->cache_name.c_str(), counter, engine, reference);
+         return false;
+      }
+      int64_t set = compare_contents(batched.levels[level], refs[level]);
+      if (set >= 0) {
+         printf("FAIL seed %" PRIu64 ", config %s: batched, %s set %" PRId64 " holds different blocks at the end\n",
+                seed, config_string(params).c_str(), batched.levels[level]->cache_name.c_str(), set);
+         return false;
+      }
+   }
+   return true;
+}
+
+int main(int argc, char *argv[]){
+   uint64_t seed = CHECK_SEED;
+   uint32_t runs = CHECK_RUNS;
+   uint32_t length = CHECK_LENGTH;
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) { seed = strtoull(argv[++i], NULL, 10); }
+      else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) { runs = (uint32_t) atoi(argv[++i]); }
+      else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc) { length = (uint32_t) atoi(argv[++i]); }
+      else {
+         printf("Error: unknown argument %s\n", argv[i]);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   // Run r uses seed + r, so a failure is reproduced with --seed <its seed> --runs 1
+   uint32_t failures = 0;
+   std::vector<trace_request_t> trace;
+   for (uint32_t r = 0; r < runs; r++) {
+      rng_state = (seed + r) * 0x9E3779B97F4A7C15ULL + 1;
+      cache_params_t params = random_config();
+      random_trace(trace, length);
+      if (!check_run(seed + r, params, trace)) { failures++; }
+   }
+   printf("differential test: %u of %u runs matched the reference\n", runs - failures, runs);
+   return failures == 0 ? 0 : 1;
+}
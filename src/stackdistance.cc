@@ -0,0 +1,162 @@
+// Stack distance (Mattson) mode: every LRU size and associativity from one pass per set count
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Cache.h"
+#include "StackDistance.h"
+#include "Trace.h"
+
+#define STACK_NONE 0xFFFFFFFFu
+
+// Prefix sums over n counters, O(log n) update and query
+class fenwick_tree{
+    public:
+    std::vector<int32_t> nodes;
+
+    fenwick_tree(size_t n) : nodes(n + 1, 0) {}
+
+    void add(uint32_t index, int32_t delta){
+       for (size_t i = (size_t)index + 1; i < this->nodes.size(); i += i & (~i + 1)) { this->nodes[i] += delta; }
+    }
+    // Sum of counters [0, index)
+    int64_t prefix(uint32_t index) const {
+       int64_t sum = 0;
+       for (size_t i = index; i > 0; i -= i & (~i + 1)) { sum += this->nodes[i]; }
+       return sum;
+    }
+};
+
+// Each set's requests get consecutive positions, so the blocks touched between two
+// requests to a block are the live positions between them. A position stays live
+// until its block is requested again.
+void stack_profile(const std::vector<uint32_t>& blocks, const std::vector<uint32_t>& ids, uint32_t num_ids,
+                   uint32_t sets, uint32_t max_assoc, stack_profile_t& profile){
+   uint32_t set_mask = sets - 1;
+   profile.sets = sets;
+   profile.cold = 0;
+   profile.far = 0;
+   profile.distance.assign(max_assoc, 0);
+
+   // First position of each set
+   std::vector<uint32_t> next_position(sets + 1, 0);
+   for (size_t i = 0; i < blocks.size(); i++) { next_position[(blocks[i] & set_mask) + 1]++; }
+   for (uint32_t set = 0; set < sets; set++) { next_position[set + 1] += next_position[set]; }
+
+   fenwick_tree live(blocks.size());
+   std::vector<uint32_t> last_position(num_ids, STACK_NONE);
+   for (size_t i = 0; i < blocks.size(); i++) {
+      uint32_t position = next_position[blocks[i] & set_mask]++;
+      uint32_t& last = last_position[ids[i]];
+      if (last == STACK_NONE) {
+         profile.cold++;
+      } else {
+         uint64_t d = live.prefix(position) - live.prefix(last + 1);
+         if (d < max_assoc) { profile.distance[d]++; }
+         else { profile.far++; }
+         live.add(last, -1);
+      }
+      live.add(position, 1);
+      last = position;
+   }
+}
+
+// An LRU set of assoc ways misses every reuse at distance >= assoc
+uint64_t stack_misses(const stack_profile_t& profile, uint32_t assoc){
+   uint64_t misses = profile.cold + profile.far;
+   for (size_t d = assoc; d < profile.distance.size(); d++) { misses += profile.distance[d]; }
+   return misses;
+}
+
+int run_stack_distance(int argc, char *argv[]){
+   // Split options from positional arguments
+   uint32_t max_size = STACK_DEFAULT_MAX_SIZE;
+   bool verify = false;
+   std::vector<const char *> args;
+   for (int i = 2; i < argc; i++) {
+      if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+         max_size = (uint32_t) atoi(argv[++i]);
+      } else if (strcmp(argv[i], "--verify") == 0) {
+         verify = true;
+      } else {
+         args.push_back(argv[i]);
+      }
+   }
+
+   if (args.size() != 2 && args.size() != 3) {
+      printf("Usage: %s --stack-distance [--max-size BYTES] [--verify] <BLOCKSIZE> <trace_file> [output_csv]\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   uint32_t blocksize = (uint32_t) atoi(args[0]);
+   const char *trace_file = args[1];
+   if (blocksize == 0 || (blocksize & (blocksize - 1)) != 0 || max_size < blocksize) {
+      printf("Error: BLOCKSIZE must be a power of two no larger than --max-size.\n");
+      exit(EXIT_FAILURE);
+   }
+
+   std::vector<trace_request_t> trace;
+   if (!load_trace(trace_file, trace)) {
+      exit(EXIT_FAILURE);
+   }
+   if (trace.size() >= STACK_NONE) {
+      printf("Error: stack distance mode handles fewer than %u requests.\n", STACK_NONE);
+      exit(EXIT_FAILURE);
+   }
+
+   // Block numbers, and a dense id per distinct block so positions can live in a vector
+   uint32_t offset_bits = __builtin_ctz(blocksize);
+   std::vector<uint32_t> blocks(trace.size());
+   std::vector<uint32_t> ids(trace.size());
+   std::unordered_map<uint32_t, uint32_t> block_ids;
+   for (size_t i = 0; i < trace.size(); i++) {
+      blocks[i] = trace[i].addr >> offset_bits;
+      ids[i] = block_ids.insert(std::make_pair(blocks[i], (uint32_t) block_ids.size())).first->second;
+   }
+
+   FILE *out = stdout;
+   if (args.size() == 3) {
+      out = fopen(args[2], "w");
+      if (out == (FILE *) NULL) {
+         printf("Error: Unable to open file %s\n", args[2]);
+         exit(EXIT_FAILURE);
+      }
+   }
+   fputs("BLOCKSIZE,SIZE,ASSOC,SETS,accesses,misses,miss_rate\n", out);
+
+   uint32_t max_blocks = max_size / blocksize;
+   uint32_t verified = 0;
+   stack_profile_t profile;
+   for (uint64_t sets = 1; sets <= max_blocks; sets *= 2) {
+      uint32_t max_assoc = max_blocks / sets;
+      stack_profile(blocks, ids, block_ids.size(), sets, max_assoc, profile);
+
+      for (uint64_t assoc = 1; assoc <= max_assoc; assoc *= 2) {
+         uint32_t size = sets * assoc * blocksize;
+         uint64_t misses = stack_misses(profile, assoc);
+         double miss_rate = trace.empty() ? 0 : static_cast<double>(misses) / static_cast<double>(trace.size());
+         fprintf(out, "%u,%u,%u,%u,%zu,%" PRIu64 ",%.4f\n", blocksize, size, (uint32_t) assoc, (uint32_t) sets, trace.size(), misses, miss_rate);
+
+         if (verify) {
+            cache L1(blocksize, size, assoc, 0, 0, NULL, "L1");
+            for (size_t i = 0; i < trace.size(); i++) {
+               L1.request(trace[i].addr, trace[i].rw);
+            }
+            uint64_t simulated = (uint64_t) L1.read_miss_count + L1.write_miss_count;
+            if (simulated != misses) {
+               printf("Error: SIZE %u ASSOC %u: stack distance gives %" PRIu64 " misses, cache::request %" PRIu64 "\n",
+                  size, (uint32_t) assoc, misses, simulated);
+               exit(EXIT_FAILURE);
+            }
+            verified++;
+         }
+      }
+   }
+
+   if (out != stdout) { fclose(out); }
+   if (verify) { fprintf(stderr, "Verified %u configurations against cache::request\n", verified); }
+   return(0);
+}
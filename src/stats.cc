@@ -0,0 +1,188 @@
+// Stats registry and the JSON / CSV reports built from it
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <string>
+
+#include "Cache.h"
+#include "Stats.h"
+
+// ------------ Class: stats_registry ------------ //
+void stats_registry::counter(const std::string& key, const std::string& label, const uint64_t& value){
+   stat_entry_t entry;
+   entry.key = key;
+   entry.label = label;
+   entry.counter = &value;
+   this->entries.push_back(entry);
+}
+
+void stats_registry::rate(const std::string& key, const std::string& label, std::function<double()> value){
+   stat_entry_t entry;
+   entry.key = key;
+   entry.label = label;
+   entry.counter = NULL;
+   entry.rate = value;
+   this->entries.push_back(entry);
+}
+
+void stats_registry::print_text() const {
+   for (size_t i = 0; i < this->entries.size(); i++) {
+      const stat_entry_t& entry = this->entries[i];
+      if (entry.counter != NULL) { printf("%-25s%" PRIu64 "\n", entry.label.c_str(), *entry.counter); }
+      else { printf("%-25s%.4f\n", entry.label.c_str(), entry.rate()); }
+   }
+}
+
+static const char *stats_format_names[] = { "text", "json", "csv" };
+
+bool parse_stats_format(const char *name, stats_format_t& format){
+   for (int i = FORMAT_TEXT; i <= FORMAT_CSV; i++) {
+      if (strcmp(name, stats_format_names[i]) == 0) {
+         format = (stats_format_t) i;
+         return true;
+      }
+   }
+   return false;
+}
+
+// ------------ JSON ------------ //
+static void json_string(FILE *out, const char *s){
+   fputc('"', out);
+   for (; *s != '\0'; s++) {
+      unsigned char ch = (unsigned char) *s;
+      if (ch == '"' || ch == '\\') { fprintf(out, "\\%c", ch); }
+      else if (ch < 0x20) { fprintf(out, "\\u%04x", ch); }
+      else { fputc(ch, out); }
+   }
+   fputc('"', out);
+}
+
+static void json_stats(FILE *out, const stats_registry& stats, const char *indent){
+   fputc('{', out);
+   for (size_t i = 0; i < stats.entries.size(); i++) {
+      const stat_entry_t& entry = stats.entries[i];
+      fprintf(out, "%s\n%s  ", i ? "," : "", indent);
+      json_string(out, entry.key.c_str());
+      if (entry.counter != NULL) { fprintf(out, ": %" PRIu64, *entry.counter); }
+      else { fprintf(out, ": %.6f", entry.rate()); }
+   }
+   fprintf(out, "\n%s}", indent);
+}
+
+// Valid blocks of each set, most to least protected, like the text dump
+static void json_contents(FILE *out, cache *c){
+   std::vector<uint32_t> ways;
+   fputc('[', out);
+   for (uint32_t set = 0; set < c->num_sets; set++) {
+      fprintf(out, "%s\n        [", set ? "," : "");
+      c->policy->order(set, ways);
+      bool first = true;
+      for (size_t k = 0; k < ways.size(); k++) {
+         if (!c->is_valid(set, ways[k])) { continue; }
+         fprintf(out, "%s{\"tag\": \"%x\", \"dirty\": %s}", first ? "" : ", ", c->tags[c->slot(set, ways[k])],
+            c->is_dirty(set, ways[k]) ? "true" : "false");
+         first = false;
+      }
+      fputc(']', out);
+   }
+   fprintf(out, "\n      ]");
+}
+
+static void write_json(FILE *out, const std::vector<const char *>& trace_files, const std::vector<cache*>& caches,
+                       const std::vector<const stats_registry*>& groups, bool contents){
+   fprintf(out, "{\n  \"trace_files\": [");
+   for (size_t i = 0; i < trace_files.size(); i++) {
+      if (i) { fprintf(out, ", "); }
+      json_string(out, trace_files[i]);
+   }
+   fprintf(out, "],\n  \"levels\": [");
+
+   for (size_t i = 0; i < caches.size(); i++) {
+      cache *c = caches[i];
+      fprintf(out, "%s\n    {\n      \"name\": ", i ? "," : "");
+      json_string(out, c->cache_name.c_str());
+      fprintf(out, ",\n      \"blocksize\": %u,\n      \"size\": %u,\n      \"assoc\": %u,\n      \"policy\": \"%s\",\n",
+         c->blocksize, c->cache_size, c->assoc, replacement_name(c->replacement));
+      fprintf(out, "      \"prefetcher\": \"%s\",\n      \"pref_n\": %u,\n      \"pref_m\": %u,\n      \"stats\": ",
+         c->prefetch_enabled ? prefetcher_name(c->prefetcher_type) : "none",
+         c->prefetch_enabled ? c->prefN : 0, c->prefetch_enabled ? c->prefM : 0);
+      json_stats(out, c->stats, "      ");
+      if (contents) {
+         fprintf(out, ",\n      \"contents\": ");
+         json_contents(out, c);
+      }
+      fprintf(out, "\n    }");
+   }
+   fprintf(out, "\n  ]");
+
+   for (size_t g = 0; g < groups.size(); g++) {
+      fprintf(out, ",\n  ");
+      json_string(out, groups[g]->group.c_str());
+      fprintf(out, ": ");
+      json_stats(out, *groups[g], "  ");
+   }
+   fprintf(out, "\n}\n");
+}
+
+// ------------ CSV ------------ //
+// Groups and values never hold commas or quotes except cache names, which are quoted when they do
+static void csv_field(FILE *out, const std::string& field){
+   if (field.find_first_of(",\"\n") == std::string::npos) {
+      fputs(field.c_str(), out);
+      return;
+   }
+   fputc('"', out);
+   for (size_t i = 0; i < field.size(); i++) {
+      if (field[i] == '"') { fputc('"', out); }
+      fputc(field[i], out);
+   }
+   fputc('"', out);
+}
+
+static void csv_row(FILE *out, const std::string& group, const char *stat, const char *value){
+   csv_field(out, group);
+   fprintf(out, ",%s,%s\n", stat, value);
+}
+
+static void csv_stats(FILE *out, const stats_registry& stats){
+   char value[64];
+   for (size_t i = 0; i < stats.entries.size(); i++) {
+      const stat_entry_t& entry = stats.entries[i];
+      if (entry.counter != NULL) { snprintf(value, sizeof(value), "%" PRIu64, *entry.counter); }
+      else { snprintf(value, sizeof(value), "%.6f", entry.rate()); }
+      csv_row(out, stats.group, entry.key.c_str(), value);
+   }
+}
+
+static void write_csv(FILE *out, const std::vector<cache*>& caches, const std::vector<const stats_registry*>& groups){
+   fputs("group,stat,value\n", out);
+   char value[64];
+   for (size_t i = 0; i < caches.size(); i++) {
+      cache *c = caches[i];
+      snprintf(value, sizeof(value), "%u", c->blocksize);
+      csv_row(out, c->cache_name, "blocksize", value);
+      snprintf(value, sizeof(value), "%u", c->cache_size);
+      csv_row(out, c->cache_name, "size", value);
+      snprintf(value, sizeof(value), "%u", c->assoc);
+      csv_row(out, c->cache_name, "assoc", value);
+      csv_row(out, c->cache_name, "policy", replacement_name(c->replacement));
+      csv_row(out, c->cache_name, "prefetcher", c->prefetch_enabled ? prefetcher_name(c->prefetcher_type) : "none");
+      snprintf(value, sizeof(value), "%u", c->prefetch_enabled ? c->prefN : 0);
+      csv_row(out, c->cache_name, "pref_n", value);
+      snprintf(value, sizeof(value), "%u", c->prefetch_enabled ? c->prefM : 0);
+      csv_row(out, c->cache_name, "pref_m", value);
+      csv_stats(out, c->stats);
+   }
+   for (size_t g = 0; g < groups.size(); g++) {
+      csv_stats(out, *groups[g]);
+   }
+}
+
+void write_stats(FILE *out, stats_format_t format, const std::vector<const char *>& trace_files,
+                 const std::vector<cache*>& caches, const std::vector<const stats_registry*>& groups, bool contents){
+   if (format == FORMAT_JSON) { write_json(out, trace_files, caches, groups, contents); }
+   else if (format == FORMAT_CSV) { write_csv(out, caches, groups); }
+}
@@ -0,0 +1,305 @@
+// Sweep mode: decode the trace once and replay it through every configuration in a grid
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Trace.h"
+#include "Sweep.h"
+#include "Events.h"
+
+#define SWEEP_FIELDS 7           // Numeric fields, in command-line order
+#define SWEEP_POLICY_FIELDS 2    // Optional L1_POLICY and L2_POLICY names
+#define SWEEP_PREFETCHER_FIELD 9 // Optional PREFETCHER name, after the policies
+
+// Split one grid field ("1024" or "1024,2048,4096") into its values
+static bool parse_sweep_field(const char *field, std::vector<uint32_t>& values){
+   const char *p = field;
+   while (*p != '\0') {
+      char *end;
+      unsigned long value = strtoul(p, &end, 10);
+      if (end == p) { return false; }
+      values.push_back((uint32_t) value);
+      if (*end == ',') { end++; }
+      else if (*end != '\0') { return false; }
+      p = end;
+   }
+   return !values.empty();
+}
+
+// Split a policy field ("lru" or "lru,srrip,drrip") into its values
+static bool parse_policy_field(char *field, std::vector<uint32_t>& values){
+   for (char *name = strtok(field, ","); name != NULL; name = strtok(NULL, ",")) {
+      replacement_t policy;
+      if (!parse_replacement(name, policy)) { return false; }
+      values.push_back(policy);
+   }
+   return !values.empty();
+}
+
+// Split a prefetcher field ("stream" or "stream,delta,markov") into its values
+static bool parse_prefetcher_field(char *field, std::vector<uint32_t>& values){
+   for (char *name = strtok(field, ","); name != NULL; name = strtok(NULL, ",")) {
+      prefetcher_t prefetcher;
+      if (!parse_prefetcher(name, prefetcher)) { return false; }
+      values.push_back(prefetcher);
+   }
+   return !values.empty();
+}
+
+bool parse_sweep_grid(const char *grid_file, std::vector<cache_params_t>& configs){
+   FILE *fp = fopen(grid_file, "r");
+   if (fp == (FILE *) NULL) {
+      printf("Error: Unable to open file %s\n", grid_file);
+      return false;
+   }
+
+   char line[1024];
+   int line_number = 0;
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      line_number++;
+
+      // Strip comments
+      char *comment = strchr(line, '#');
+      if (comment != NULL) { *comment = '\0'; }
+
+      const int total_fields = SWEEP_FIELDS + SWEEP_POLICY_FIELDS + 1;
+      std::vector<char *> tokens;
+      char *save;
+      for (char *tok = strtok_r(line, " \t\r\n", &save); tok != NULL; tok = strtok_r(NULL, " \t\r\n", &save)) {
+         tokens.push_back(tok);
+      }
+      if (tokens.empty()) { continue; }      // Blank line
+      if (tokens.size() < SWEEP_FIELDS || tokens.size() > total_fields) {
+         printf("Error: %s:%d: expected %d to %d fields but found %d\n", grid_file, line_number, SWEEP_FIELDS, total_fields, (int) tokens.size());
+         fclose(fp);
+         return false;
+      }
+
+      std::vector<uint32_t> fields[total_fields];
+      bool ok = true;
+      for (int f = 0; f < total_fields && ok; f++) {
+         if (f >= (int) tokens.size()) {
+            // Policy fields default to LRU, the prefetcher to the stream buffers
+            fields[f].push_back(f == SWEEP_PREFETCHER_FIELD ? (uint32_t) PREF_STREAM : (uint32_t) REPL_LRU);
+         } else if (f < SWEEP_FIELDS) {
+            ok = parse_sweep_field(tokens[f], fields[f]);
+         } else if (f == SWEEP_PREFETCHER_FIELD) {
+            ok = parse_prefetcher_field(tokens[f], fields[f]);
+         } else {
+            ok = parse_policy_field(tokens[f], fields[f]);
+         }
+      }
+      if (!ok) {
+         printf("Error: %s:%d: malformed grid line\n", grid_file, line_number);
+         fclose(fp);
+         return false;
+      }
+
+      // Expand the cartesian product, first field outermost
+      size_t pos[total_fields] = {0};
+      while (true) {
+         cache_params_t params;
+         params.BLOCKSIZE = fields[0][pos[0]];
+         params.L1_SIZE   = fields[1][pos[1]];
+         params.L1_ASSOC  = fields[2][pos[2]];
+         params.L2_SIZE   = fields[3][pos[3]];
+         params.L2_ASSOC  = fields[4][pos[4]];
+         params.PREF_N    = fields[5][pos[5]];
+         params.PREF_M    = fields[6][pos[6]];
+         params.L1_POLICY = fields[7][pos[7]];
+         params.L2_POLICY = fields[8][pos[8]];
+         params.PREFETCHER = fields[9][pos[9]];
+
+         if (valid_cache_params(params)) {
+            configs.push_back(params);
+         } else {
+            fprintf(stderr, "Skipping invalid configuration %u %u %u %u %u %u %u %s %s %s\n",
+               params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, params.L2_SIZE, params.L2_ASSOC, params.PREF_N, params.PREF_M,
+               replacement_name((replacement_t) params.L1_POLICY), replacement_name((replacement_t) params.L2_POLICY),
+               prefetcher_name((prefetcher_t) params.PREFETCHER));
+         }
+
+         int f = total_fields - 1;
+         while (f >= 0 && ++pos[f] == fields[f].size()) {
+            pos[f] = 0;
+            f--;
+         }
+         if (f < 0) { break; }
+      }
+   }
+   fclose(fp);
+   return true;
+}
+
+std::string sweep_csv_header(){
+   return "BLOCKSIZE,L1_SIZE,L1_ASSOC,L2_SIZE,L2_ASSOC,PREF_N,PREF_M,"
+          "L1_reads,L1_read_misses,L1_writes,L1_write_misses,L1_miss_rate,L1_writebacks,L1_prefetches,"
+          "L2_reads_demand,L2_read_misses_demand,L2_reads_prefetch,L2_read_misses_prefetch,"
+          "L2_writes,L2_write_misses,L2_miss_rate,L2_writebacks,L2_prefetches,memory_traffic,"
+          "L1_POLICY,L2_POLICY,PREFETCHER,prefetches_useful,prefetches_late,prefetches_polluting\n";
+}
+
+// Run one configuration over the decoded trace and format its CSV row (measurements a - q)
+std::string simulate_sweep_config(const cache_params_t& params, const std::vector<trace_request_t>& trace){
+   cache_hierarchy hierarchy(params);
+   hierarchy.request_batch(trace.data(), trace.size());
+
+   const cache *L1 = hierarchy.L1;
+   const cache *L2 = hierarchy.L2;
+   double L1_miss_rate = static_cast<double>(L1->write_miss_count + L1->read_miss_count) / static_cast<double>(L1->writes + L1->reads);
+
+   char row[512];
+   int len = snprintf(row, sizeof(row), "%u,%u,%u,%u,%u,%u,%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64 ",%" PRIu64 ",",
+      params.BLOCKSIZE, params.L1_SIZE, params.L1_ASSOC, params.L2_SIZE, params.L2_ASSOC, params.PREF_N, params.PREF_M,
+      L1->reads, L1->read_miss_count, L1->writes, L1->write_miss_count, L1_miss_rate, L1->writeback, L1->prefetches);
+
+   if (L2 != NULL) {
+      double L2_miss_rate = static_cast<double>(L2->read_miss_count) / static_cast<double>(L2->reads);
+      len += snprintf(row + len, sizeof(row) - len, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",",
+         L2->reads, L2->read_miss_count, L2->reads_prefetch, L2->read_miss_prefetch,
+         L2->writes, L2->write_miss_count, L2_miss_rate, L2->writeback, L2->prefetches, L2->memory_traffic);
+   } else {
+      len += snprintf(row + len, sizeof(row) - len, "0,0,0,0,0,0,0.0000,0,0,%" PRIu64 ",", L1->memory_traffic);
+   }
+
+   // Prefetch effectiveness of whichever level PREF_N/PREF_M applied to
+   const cache *pref = (L2 != NULL) ? L2 : L1;
+   snprintf(row + len, sizeof(row) - len, "%s,%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+      replacement_name((replacement_t) params.L1_POLICY), replacement_name((replacement_t) params.L2_POLICY),
+      prefetcher_name((prefetcher_t) params.PREFETCHER), pref->prefetches_useful, pref->prefetches_late, pref->prefetches_polluting);
+   return std::string(row);
+}
+
+// Per-worker deques of config indices. A worker pops from the front of its own
+// deque and, once that is empty, steals from the back of the others.
+class sweep_work_queue{
+    public:
+    std::vector<std::deque<size_t> > work;
+    std::vector<std::mutex> locks;
+
+    // Constructor: deal contiguous blocks of configs to each worker
+    sweep_work_queue(size_t num_configs, unsigned num_workers) : work(num_workers), locks(num_workers) {
+        for (size_t i = 0; i < num_configs; i++) {
+            work[i * num_workers / num_configs].push_back(i);
+        }
+    }
+
+    bool next(unsigned worker, size_t& config){
+        {
+            std::lock_guard<std::mutex> guard(locks[worker]);
+            if (!work[worker].empty()) {
+                config = work[worker].front();
+                work[worker].pop_front();
+                return true;
+            }
+        }
+        for (unsigned i = 1; i < work.size(); i++) {
+            unsigned victim = (worker + i) % work.size();
+            std::lock_guard<std::mutex> guard(locks[victim]);
+            if (!work[victim].empty()) {
+                config = work[victim].back();
+                work[victim].pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+void run_sweep_configs(const std::vector<cache_params_t>& configs, const std::vector<trace_request_t>& trace,
+                       unsigned num_threads, std::vector<std::string>& rows){
+   rows.assign(configs.size(), std::string());
+   if (num_threads > configs.size()) { num_threads = configs.size(); }
+
+   if (num_threads <= 1) {
+      for (size_t i = 0; i < configs.size(); i++) {
+         TRACE_EVENT(EV_CONFIG, 0, 0, EVENT_NO_WAY, (uint32_t) i);
+         rows[i] = simulate_sweep_config(configs[i], trace);
+      }
+      return;
+   }
+
+   // Each row slot is written by exactly one worker, so no locking is needed on rows
+   sweep_work_queue queue(configs.size(), num_threads);
+   std::vector<std::thread> workers;
+   for (unsigned t = 0; t < num_threads; t++) {
+      workers.emplace_back([&, t]() {
+         size_t config;
+         while (queue.next(t, config)) {
+            TRACE_EVENT(EV_CONFIG, 0, 0, EVENT_NO_WAY, (uint32_t) config);
+            rows[config] = simulate_sweep_config(configs[config], trace);
+         }
+      });
+   }
+   for (size_t t = 0; t < workers.size(); t++) {
+      workers[t].join();
+   }
+}
+
+int run_sweep(int argc, char *argv[]){
+   // Split options from positional arguments
+   unsigned num_threads = 1;
+   std::vector<const char *> args;
+   for (int i = 2; i < argc; i++) {
+      if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+         num_threads = (unsigned) atoi(argv[++i]);
+         if (num_threads == 0) { num_threads = std::thread::hardware_concurrency(); }
+      } else if (strcmp(argv[i], "--events") == 0) {
+         if (i + 1 >= argc || argv[i + 1][0] == '-') {
+            printf("Error: --events expects a file to write.\n");
+            exit(EXIT_FAILURE);
+         }
+         open_event_trace(argv[++i]);
+      } else {
+         args.push_back(argv[i]);
+      }
+   }
+
+   if (args.size() != 2 && args.size() != 3) {
+      printf("Usage: %s --sweep [--threads N] [--events file] <grid_file> <trace_file> [output_csv]\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   const char *grid_file  = args[0];
+   const char *trace_file = args[1];
+
+   std::vector<cache_params_t> configs;
+   if (!parse_sweep_grid(grid_file, configs)) {
+      exit(EXIT_FAILURE);
+   }
+
+   // Decode the trace once for every configuration; workers only read it
+   std::vector<trace_request_t> trace;
+   if (!load_trace(trace_file, trace)) {
+      exit(EXIT_FAILURE);
+   }
+
+   std::vector<std::string> rows;
+   run_sweep_configs(configs, trace, num_threads, rows);
+   event_trace_close();
+
+   FILE *out = stdout;
+   if (args.size() == 3) {
+      out = fopen(args[2], "w");
+      if (out == (FILE *) NULL) {
+         printf("Error: Unable to open file %s\n", args[2]);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   fputs(sweep_csv_header().c_str(), out);
+   for (size_t i = 0; i < rows.size(); i++) {
+      fputs(rows[i].c_str(), out);
+   }
+
+   if (out != stdout) { fclose(out); }
+   return(0);
+}
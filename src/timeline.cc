@@ -0,0 +1,161 @@
+// Interval statistics: per-interval counter deltas and the phases they show
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <cmath>
+#include <vector>
+#include <string>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Timeline.h"
+
+// ------------ Class: interval_timeline ------------ //
+interval_timeline::interval_timeline(cache_hierarchy& hierarchy, const timeline_params_t& params, uint64_t start){
+   this->params = params;
+   this->caches = hierarchy.levels;
+   this->out = fopen(params.FILE_NAME, "w");
+   if (this->out == (FILE *) NULL) {
+      printf("Error: Unable to open file %s\n", params.FILE_NAME);
+      exit(EXIT_FAILURE);
+   }
+
+   fprintf(this->out, "position");
+   for (size_t i = 0; i < this->caches.size(); i++) {
+      const char *name = this->caches[i]->cache_name.c_str();
+      fprintf(this->out, ",%s_reads,%s_misses,%s_writebacks,%s_prefetches", name, name, name, name);
+   }
+   fprintf(this->out, ",memory_traffic\n");
+
+   this->start = start;
+   this->next = (start / params.INTERVAL + 1) * params.INTERVAL;
+   this->last_position = start;
+   this->read_counters(this->last);
+}
+
+interval_timeline::~interval_timeline(){
+   if (this->out != NULL) { fclose(this->out); }
+}
+
+void interval_timeline::read_counters(std::vector<uint64_t>& counters) const {
+   counters.clear();
+   for (size_t i = 0; i < this->caches.size(); i++) {
+      const cache *c = this->caches[i];
+      counters.push_back(c->reads);
+      counters.push_back(c->read_miss_count + c->write_miss_count);
+      counters.push_back(c->writeback);
+      counters.push_back(c->prefetches);
+   }
+   counters.push_back(this->caches.back()->memory_traffic);
+}
+
+void interval_timeline::snapshot(uint64_t position){
+   std::vector<uint64_t> counters;
+   this->read_counters(counters);
+
+   double requests = static_cast<double>(position - this->last_position);
+   std::vector<double> signature;
+   fprintf(this->out, "%" PRIu64, position);
+   for (size_t k = 0; k < counters.size(); k++) {
+      uint64_t delta = counters[k] - this->last[k];
+      fprintf(this->out, ",%" PRIu64, delta);
+      if (k % TIMELINE_LEVEL_COUNTERS == 1 || k + 1 == counters.size()) { signature.push_back(delta / requests); }
+   }
+   fprintf(this->out, "\n");
+
+   this->ends.push_back(position);
+   this->signatures.push_back(signature);
+   this->last.swap(counters);
+   this->last_position = position;
+   this->next += this->params.INTERVAL;
+}
+
+void interval_timeline::finish(uint64_t position){
+   if (position > this->last_position) { this->snapshot(position); }
+   if (fclose(this->out) != 0) {
+      printf("Error: Unable to write %s\n", this->params.FILE_NAME);
+      exit(EXIT_FAILURE);
+   }
+   this->out = NULL;
+}
+
+// Distance of a signature from a phase mean, relative to their size
+static double signature_distance(const std::vector<double>& a, const std::vector<double>& mean){
+   double diff = 0, size = 0;
+   for (size_t k = 0; k < a.size(); k++) {
+      diff += std::fabs(a[k] - mean[k]);
+      size += (a[k] + mean[k]) / 2;
+   }
+   return (size > 0) ? diff / size : 0;
+}
+
+void interval_timeline::print_phases(FILE *report){
+   size_t num_intervals = this->signatures.size();
+   fprintf(report, "===== Phases =====\n");
+   fprintf(report, "interval:                %" PRIu64 " requests\n", this->params.INTERVAL);
+   fprintf(report, "threshold:               %.2f\n", this->params.THRESHOLD);
+   if (num_intervals == 0) {
+      fprintf(report, "phases:                  0\n\n");
+      return;
+   }
+
+   // Phase boundaries: two intervals in a row away from the running mean (weighted by requests)
+   // of a phase at least TIMELINE_MIN_PHASE intervals long
+   size_t width = this->signatures[0].size();
+   std::vector<size_t> first(1, 0);
+   std::vector<double> sum(width, 0), mean(width, 0);
+   double weight = 0;
+   for (size_t i = 0; i < num_intervals; i++) {
+      double requests = static_cast<double>(this->ends[i] - (i ? this->ends[i - 1] : this->start));
+      if (i >= first.back() + TIMELINE_MIN_PHASE) {
+         for (size_t k = 0; k < width; k++) { mean[k] = sum[k] / weight; }
+         bool away = signature_distance(this->signatures[i], mean) > this->params.THRESHOLD;
+         bool next_away = (i + 1 < num_intervals) && signature_distance(this->signatures[i + 1], mean) > this->params.THRESHOLD;
+         if (away && next_away) {
+            first.push_back(i);
+            sum.assign(width, 0);
+            weight = 0;
+         }
+      }
+      for (size_t k = 0; k < width; k++) { sum[k] += this->signatures[i][k] * requests; }
+      weight += requests;
+   }
+   first.push_back(num_intervals);
+
+   fprintf(report, "phases:                  %zu\n", first.size() - 1);
+   fprintf(report, "%-7s%-24s%-9s%-24s", "phase", "requests", "share", "representative");
+   for (size_t i = 0; i < this->caches.size(); i++) {
+      fprintf(report, "%12s", (this->caches[i]->cache_name + " MPKI").c_str());
+   }
+   fprintf(report, "%12s\n", "memory/KI");
+
+   double total = static_cast<double>(this->ends.back() - this->start);
+   for (size_t p = 0; p + 1 < first.size(); p++) {
+      size_t begin = first[p], end = first[p + 1];
+      uint64_t from = begin ? this->ends[begin - 1] : this->start;
+      uint64_t to = this->ends[end - 1];
+
+      sum.assign(width, 0);
+      for (size_t i = begin; i < end; i++) {
+         double requests = static_cast<double>(this->ends[i] - (i ? this->ends[i - 1] : this->start));
+         for (size_t k = 0; k < width; k++) { sum[k] += this->signatures[i][k] * requests; }
+      }
+      for (size_t k = 0; k < width; k++) { mean[k] = sum[k] / static_cast<double>(to - from); }
+
+      size_t representative = begin;
+      for (size_t i = begin + 1; i < end; i++) {
+         if (signature_distance(this->signatures[i], mean) < signature_distance(this->signatures[representative], mean)) { representative = i; }
+      }
+
+      char range[48], window[48];
+      snprintf(range, sizeof(range), "%" PRIu64 "-%" PRIu64, from, to - 1);
+      snprintf(window, sizeof(window), "%" PRIu64 "-%" PRIu64, representative ? this->ends[representative - 1] : this->start,
+         this->ends[representative] - 1);
+      fprintf(report, "%-7zu%-24s%5.1f%%   %-24s", p, range, 100.0 * (to - from) / total, window);
+      for (size_t k = 0; k < width; k++) { fprintf(report, "%12.2f", 1000.0 * mean[k]); }
+      fprintf(report, "\n");
+   }
+   fprintf(report, "\n");
+}
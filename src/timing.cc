@@ -0,0 +1,262 @@
+// Timing model: hit latencies, MSHRs with miss merging and a DRAM channel
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "Cache.h"
+#include "Hierarchy.h"
+#include "Timing.h"
+
+// Hit latency of level i unless --hit-latency says otherwise
+static const uint32_t default_hit_latency[] = { 4, 12, 40 };
+
+void timing_level_defaults(timing_params_t& params, uint32_t num_levels){
+   for (uint32_t i = params.HIT_LATENCY.size(); i < num_levels; i++) {
+      params.HIT_LATENCY.push_back(default_hit_latency[std::min(i, 2u)]);
+   }
+}
+
+bool parse_hit_latency(const char *spec, timing_params_t& params){
+   params.HIT_LATENCY.clear();
+   const char *pos = spec;
+   while (*pos != '\0') {
+      char *end;
+      unsigned long latency = strtoul(pos, &end, 10);
+      if (end == pos || (*end != ',' && *end != '\0')) { return false; }
+      params.HIT_LATENCY.push_back((uint32_t) latency);
+      pos = (*end == ',') ? end + 1 : end;
+   }
+   return !params.HIT_LATENCY.empty();
+}
+
+bool parse_dram_timing(const char *spec, timing_params_t& params){
+   unsigned latency, interval;
+   if (sscanf(spec, "%u,%u", &latency, &interval) != 2) { return false; }
+   params.DRAM_LATENCY = latency;
+   params.DRAM_INTERVAL = interval;
+   return true;
+}
+
+// ------------ Class: timing_model ------------ //
+timing_model::timing_model(cache_hierarchy& hierarchy, const timing_params_t& params){
+   this->params = params;
+   this->caches = hierarchy.levels;
+   this->levels.resize(this->caches.size());
+   for (size_t i = 0; i < this->caches.size(); i++) {
+      timing_level_t& level = this->levels[i];
+      level.hit_latency = params.HIT_LATENCY[i];
+      mshr_entry_t free_entry = { 0, 0 };
+      level.mshrs.assign(params.MSHRS, free_entry);
+      level.served = 0;
+      level.merges = 0;
+      level.mshr_stall_cycles = 0;
+      this->caches[i]->timing = this;
+   }
+   this->now = 0;
+   this->next_issue = 0;
+   this->dram_free = 0;
+   this->dram_blocks = 0;
+   this->finish = 0;
+   this->requests = 0;
+   this->memory_served = 0;
+   this->total_latency = 0;
+   memset(this->histogram, 0, sizeof(this->histogram));
+   this->prefetch_timely = 0;
+   this->prefetch_late = 0;
+   this->prefetch_wait_cycles = 0;
+}
+
+void timing_model::request(uint32_t addr, char rw){
+   this->now = this->next_issue;
+   this->next_issue = this->now + 1;
+   this->dram_blocks = 0;
+   uint64_t traffic = this->caches.back()->memory_traffic;
+
+   uint64_t done = this->service(0, addr, this->now, true);
+   this->caches[0]->request(addr, rw);
+
+   // Memory transfers the walk did not time (writebacks) still occupy the channel
+   uint64_t transfers = this->caches.back()->memory_traffic - traffic;
+   for (uint64_t i = this->dram_blocks; i < transfers; i++) {
+      this->dram_free = std::max(this->dram_free, this->now) + this->params.DRAM_INTERVAL;
+   }
+
+   uint64_t latency = done - this->now;
+   uint32_t bucket = (latency == 0) ? 0 : 64 - __builtin_clzll(latency);
+   this->histogram[std::min(bucket, (uint32_t) TIMING_HISTOGRAM_BUCKETS - 1)]++;
+   this->total_latency += latency;
+   this->requests++;
+   this->finish = std::max(this->finish, done);
+}
+
+// Start a block on the DRAM channel at or after t; returns the cycle it arrives
+uint64_t timing_model::dram(uint64_t t){
+   uint64_t start = std::max(t, this->dram_free);
+   this->dram_free = start + this->params.DRAM_INTERVAL;
+   this->dram_blocks++;
+   return start + this->params.DRAM_LATENCY;
+}
+
+// Completion cycle of addr entering level first at cycle t. Demand misses take
+// MSHRs and are counted; prefetch walks only find their arrival time.
+uint64_t timing_model::service(uint32_t first, uint32_t addr, uint64_t t, bool demand){
+   mshr_entry_t *missed[64];
+   uint32_t num_missed = 0;
+   uint64_t done = 0;
+   bool found = false;
+
+   for (uint32_t i = first; i < this->caches.size() && !found; i++) {
+      cache *c = this->caches[i];
+      timing_level_t& level = this->levels[i];
+      uint32_t block = addr >> c->blockoffset_size;
+
+      // Join an outstanding miss for the block
+      for (size_t m = 0; m < level.mshrs.size(); m++) {
+         if (level.mshrs[m].block == block && level.mshrs[m].ready > t) {
+            if (demand) { level.merges++; }
+            done = std::max(level.mshrs[m].ready, t + level.hit_latency);
+            found = true;
+            break;
+         }
+      }
+      if (found) { break; }
+
+      // Or wait for a prefetch still on its way
+      std::unordered_map<uint32_t, uint64_t>::iterator prefetch = level.prefetches.find(block);
+      if (prefetch != level.prefetches.end()) {
+         uint64_t arrival = prefetch->second;
+         level.prefetches.erase(prefetch);
+         if (arrival > t + level.hit_latency) {
+            if (demand) {
+               this->prefetch_late++;
+               this->prefetch_wait_cycles += arrival - (t + level.hit_latency);
+               level.served++;
+            }
+            done = arrival;
+            found = true;
+            break;
+         }
+      }
+
+      t += level.hit_latency;
+      uint32_t set, way, index;
+      if (c->find_block(addr, set, way)) {
+         if (demand && c->prefetch_engine != NULL && c->is_prefetched(set, way)) { this->prefetch_timely++; }
+         found = true;
+      } else if (c->prefetch_enabled && c->prefetch_engine == NULL && c->searchStreamBuffer(addr, index)) {
+         if (demand) { this->prefetch_timely++; }
+         found = true;
+      }
+      if (found) {
+         if (demand) { level.served++; }
+         done = t;
+         break;
+      }
+      if (!demand) { continue; }
+
+      // Miss: take a free MSHR, stalling until the first one frees if none is
+      mshr_entry_t *entry = &level.mshrs[0];
+      for (size_t m = 1; m < level.mshrs.size() && entry->ready > t; m++) {
+         if (level.mshrs[m].ready < entry->ready) { entry = &level.mshrs[m]; }
+      }
+      if (entry->ready > t) {
+         level.mshr_stall_cycles += entry->ready - t;
+         t = entry->ready;
+         if (i == 0) { this->next_issue = std::max(this->next_issue, t); }
+      }
+      entry->block = block;
+      if (num_missed < 64) { missed[num_missed++] = entry; }
+   }
+
+   if (!found) {
+      done = this->dram(t);
+      if (demand) { this->memory_served++; }
+   }
+   for (uint32_t m = 0; m < num_missed; m++) {
+      missed[m]->ready = done;
+   }
+   return done;
+}
+
+void timing_model::on_prefetch(const cache *level, uint32_t block){
+   size_t j = 0;
+   uint64_t t = this->now;
+   while (this->caches[j] != level) {
+      t += this->levels[j].hit_latency;
+      j++;
+   }
+   t += this->levels[j].hit_latency;
+
+   uint32_t addr = block << level->blockoffset_size;
+   uint64_t arrival = (j + 1 < this->caches.size()) ? this->service(j + 1, addr, t, false) : this->dram(t);
+
+   std::unordered_map<uint32_t, uint64_t>& prefetches = this->levels[j].prefetches;
+   if (prefetches.size() >= TIMING_PURGE_SIZE) {
+      for (std::unordered_map<uint32_t, uint64_t>::iterator p = prefetches.begin(); p != prefetches.end(); ) {
+         if (p->second <= this->now) { p = prefetches.erase(p); }
+         else { ++p; }
+      }
+   }
+   prefetches[block] = arrival;
+}
+
+void timing_model::print_measurements(){
+   printf("===== Timing =====\n");
+   printf("hit latency:            ");
+   for (size_t i = 0; i < this->caches.size(); i++) {
+      printf(" %s %u%s", this->caches[i]->cache_name.c_str(), this->levels[i].hit_latency, (i + 1 < this->caches.size()) ? "," : "\n");
+   }
+   printf("MSHRs per level:         %u\n", this->params.MSHRS);
+   printf("DRAM:                    %u cycles, a block every %u cycles\n", this->params.DRAM_LATENCY, this->params.DRAM_INTERVAL);
+   printf("requests:                %" PRIu64 "\n", this->requests);
+   printf("cycles:                  %" PRIu64 "\n", this->finish);
+   printf("AMAT:                    %.4f\n", this->requests ? static_cast<double>(this->total_latency) / this->requests : 0.0);
+   for (size_t i = 0; i < this->caches.size(); i++) {
+      const timing_level_t& level = this->levels[i];
+      std::string name = this->caches[i]->cache_name;
+      printf("%-25s%" PRIu64 "\n", (name + " served:").c_str(), level.served);
+      printf("%-25s%" PRIu64 "\n", (name + " MSHR merges:").c_str(), level.merges);
+      printf("%-25s%" PRIu64 "\n", (name + " MSHR stall cycles:").c_str(), level.mshr_stall_cycles);
+   }
+   printf("memory served:           %" PRIu64 "\n", this->memory_served);
+   printf("prefetches on time:      %" PRIu64 "\n", this->prefetch_timely);
+   printf("prefetches late:         %" PRIu64 "\n", this->prefetch_late);
+   printf("late prefetch wait:      %" PRIu64 " cycles\n", this->prefetch_wait_cycles);
+
+   printf("latency histogram:\n");
+   for (uint32_t b = 0; b < TIMING_HISTOGRAM_BUCKETS; b++) {
+      if (this->histogram[b] == 0) { continue; }
+      char range[48];
+      if (b == 0) { snprintf(range, sizeof(range), "0:"); }
+      else if (b == 1) { snprintf(range, sizeof(range), "1:"); }
+      else if (b == TIMING_HISTOGRAM_BUCKETS - 1) { snprintf(range, sizeof(range), "%" PRIu64 "+:", (uint64_t)1 << (b - 1)); }
+      else { snprintf(range, sizeof(range), "%" PRIu64 "-%" PRIu64 ":", (uint64_t)1 << (b - 1), ((uint64_t)1 << b) - 1); }
+      printf("   %-22s%" PRIu64 "\n", range, this->histogram[b]);
+   }
+   printf("\n");
+}
+
+void timing_model::register_stats(stats_registry& registry) const {
+   registry.group = "timing";
+   registry.counter("requests", "requests:", this->requests);
+   registry.counter("cycles", "cycles:", this->finish);
+   registry.rate("amat", "AMAT:", [this]() {
+      return this->requests ? static_cast<double>(this->total_latency) / this->requests : 0.0;
+   });
+   for (size_t i = 0; i < this->caches.size(); i++) {
+      const timing_level_t& level = this->levels[i];
+      const std::string& name = this->caches[i]->cache_name;
+      registry.counter(name + "_served", name + " served:", level.served);
+      registry.counter(name + "_mshr_merges", name + " MSHR merges:", level.merges);
+      registry.counter(name + "_mshr_stall_cycles", name + " MSHR stall cycles:", level.mshr_stall_cycles);
+   }
+   registry.counter("memory_served", "memory served:", this->memory_served);
+   registry.counter("prefetches_on_time", "prefetches on time:", this->prefetch_timely);
+   registry.counter("prefetches_late", "prefetches late:", this->prefetch_late);
+   registry.counter("late_prefetch_wait_cycles", "late prefetch wait:", this->prefetch_wait_cycles);
+}
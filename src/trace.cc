@@ -0,0 +1,562 @@
+// Trace decoding shared by the normal and sweep drivers
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Trace.h"
+
+bool load_trace(const char *trace_file, std::vector<trace_request_t>& trace){
+   trace_request_t req;
+
+   if (is_binary_trace(trace_file)) {
+      mapped_trace bin_trace;
+      if (!bin_trace.open(trace_file)) {
+         printf("Error: Unable to map binary trace %s: %s\n", trace_file, bin_trace.error);
+         return false;
+      }
+      trace.reserve(bin_trace.count);
+      for (uint64_t i = 0; i < bin_trace.count; i++) {
+         req.addr = bin_trace.addr(i);
+         req.rw = bin_trace.rw(i);
+         trace.push_back(req);
+      }
+      return true;
+   }
+
+   text_trace_reader reader;
+   if (!reader.open(trace_file)) {
+      printf("Error: Unable to open file %s\n", trace_file);
+      return false;
+   }
+
+   trace_status_t status;
+   while ((status = reader.next(req.addr, req.rw)) == TRACE_OK) {
+      trace.push_back(req);
+   }
+   if (status == TRACE_ERROR) {
+      printf("Error: %s:%" PRIu64 ": %s\n", trace_file, reader.line, reader.error);
+      return false;
+   }
+   return true;
+}
+
+// ------------ Text traces ------------ //
+trace_compression_t detect_trace_compression(const char *trace_file){
+   unsigned char magic[4] = {0, 0, 0, 0};
+   FILE *fp = fopen(trace_file, "rb");
+   if (fp == (FILE *) NULL) {
+      return TRACE_PLAIN;
+   }
+   size_t n = fread(magic, 1, sizeof(magic), fp);
+   fclose(fp);
+
+   if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) { return TRACE_GZIP; }
+   if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) { return TRACE_ZSTD; }
+   return TRACE_PLAIN;
+}
+
+text_trace_reader::text_trace_reader(){
+   this->line = 0;
+   this->timestamp = 0;
+   this->error[0] = '\0';
+   this->fd = -1;
+   this->compression = TRACE_PLAIN;
+   this->gz = nullptr;
+   this->zstd = nullptr;
+   this->zbuf = nullptr;
+   this->zpos = 0;
+   this->zend = 0;
+   this->zframe_open = false;
+   this->read_failed = false;
+   this->buf = nullptr;
+   this->pos = 0;
+   this->end = 0;
+   this->eof = true;
+}
+
+text_trace_reader::~text_trace_reader(){
+   this->close();
+}
+
+bool text_trace_reader::open(const char *trace_file){
+   this->close();
+   this->compression = detect_trace_compression(trace_file);
+#ifndef HAVE_ZSTD
+   if (this->compression == TRACE_ZSTD) {
+      printf("Error: %s is zstd compressed; rebuild with \"make ZSTD=1\" to read it\n", trace_file);
+      return false;
+   }
+#endif
+   this->fd = ::open(trace_file, O_RDONLY);
+   if (this->fd < 0) {
+      return false;
+   }
+
+   if (this->compression == TRACE_GZIP) {
+      gzFile file = gzdopen(this->fd, "rb");
+      if (file == NULL) {
+         ::close(this->fd);
+         this->fd = -1;
+         return false;
+      }
+      gzbuffer(file, TRACE_TEXT_CHUNK / 4);
+      this->gz = file;
+      this->fd = -1;    // Owned by gz now
+   }
+#ifdef HAVE_ZSTD
+   if (this->compression == TRACE_ZSTD) {
+      ZSTD_DStream *stream = ZSTD_createDStream();
+      ZSTD_initDStream(stream);
+      this->zstd = stream;
+      this->zbuf = new char[ZSTD_DStreamInSize()];
+      this->zpos = 0;
+      this->zend = 0;
+      this->zframe_open = false;
+   }
+#endif
+   this->buf = new char[TRACE_TEXT_CHUNK + TRACE_TEXT_WINDOW + TRACE_TEXT_PAD];
+   this->pos = 0;
+   this->end = 0;
+   this->eof = false;
+   this->line = 1;
+   this->refill();
+   return true;
+}
+
+void text_trace_reader::close(){
+   if (this->fd >= 0) {
+      ::close(this->fd);
+   }
+   if (this->gz != nullptr) {
+      gzclose((gzFile) this->gz);
+   }
+#ifdef HAVE_ZSTD
+   if (this->zstd != nullptr) {
+      ZSTD_freeDStream((ZSTD_DStream *) this->zstd);
+   }
+#endif
+   delete[] this->zbuf;
+   this->gz = nullptr;
+   this->zstd = nullptr;
+   this->zbuf = nullptr;
+   this->compression = TRACE_PLAIN;
+   this->read_failed = false;
+   delete[] this->buf;
+   this->fd = -1;
+   this->buf = nullptr;
+   this->pos = 0;
+   this->end = 0;
+   this->eof = true;
+}
+
+// Read up to n decompressed bytes. Returns 0 at end of input, < 0 on error.
+long text_trace_reader::read_bytes(char *dst, size_t n){
+   if (this->compression == TRACE_GZIP) {
+      int got = gzread((gzFile) this->gz, dst, (unsigned) n);
+      int err = Z_OK;
+      if (got == 0) {
+         gzerror((gzFile) this->gz, &err);     // A truncated stream ends with Z_BUF_ERROR
+      }
+      return (err == Z_OK || err == Z_STREAM_END) ? got : -1;
+   }
+#ifdef HAVE_ZSTD
+   if (this->compression == TRACE_ZSTD) {
+      ZSTD_outBuffer output = { dst, n, 0 };
+      while (output.pos == 0) {
+         if (this->zpos == this->zend) {
+            ssize_t got = read(this->fd, this->zbuf, ZSTD_DStreamInSize());
+            if (got == 0 && this->zframe_open) { return -1; }    // Truncated frame
+            if (got <= 0) { return got; }
+            this->zpos = 0;
+            this->zend = got;
+         }
+         ZSTD_inBuffer input = { this->zbuf, this->zend, this->zpos };
+         size_t ret = ZSTD_decompressStream((ZSTD_DStream *) this->zstd, &output, &input);
+         this->zpos = input.pos;
+         if (ZSTD_isError(ret)) { return -1; }
+         this->zframe_open = ret != 0;
+      }
+      return (long) output.pos;
+   }
+#endif
+   return read(this->fd, dst, n);
+}
+
+// Slide the unread tail to the front of the buffer and read the next chunk behind it
+void text_trace_reader::refill(){
+   size_t tail = this->end - this->pos;
+   memmove(this->buf, this->buf + this->pos, tail);
+   this->pos = 0;
+   this->end = tail;
+
+   while (!this->eof && this->end < TRACE_TEXT_WINDOW) {
+      long n = this->read_bytes(this->buf + this->end, TRACE_TEXT_CHUNK);
+      if (n <= 0) {
+         this->eof = true;
+         this->read_failed = n < 0;
+      } else {
+         this->end += n;
+      }
+   }
+
+   // Sentinel whitespace so the word-at-a-time decode never reads stale bytes
+   memset(this->buf + this->end, '\n', TRACE_TEXT_PAD);
+}
+
+void text_trace_reader::skip_space(){
+   while (true) {
+      while (this->pos < this->end && (unsigned char) this->buf[this->pos] <= ' ') {
+         if (this->buf[this->pos] == '\n') { this->line++; }
+         this->pos++;
+      }
+      if (this->pos < this->end || this->eof) { return; }
+      this->refill();
+   }
+}
+
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_HIGHS 0x8080808080808080ULL
+
+// High bit of each byte set where lo <= byte <= hi (bytes must be < 0x80)
+static inline uint64_t swar_in_range(uint64_t x, uint8_t lo, uint8_t hi){
+   uint64_t ge_lo = (x + SWAR_ONES * (uint64_t)(0x80 - lo)) & SWAR_HIGHS;
+   uint64_t gt_hi = (x + SWAR_ONES * (uint64_t)(0x7F - hi)) & SWAR_HIGHS;
+   return ge_lo & ~gt_hi;
+}
+
+// Decode up to eight hex digits starting at p. Returns the number of characters
+// consumed, or 0 if p does not start with a hex number terminated by whitespace
+// within eight characters (the caller then falls back to the scalar path).
+static inline int swar_parse_hex(const char *p, uint32_t& value){
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   uint64_t x, y;
+   memcpy(&x, p, 8);
+   memcpy(&y, p + 8, 1);
+
+   // Digits run up to the first byte <= ' '
+   uint64_t term = (x - SWAR_ONES * 0x21) & ~x & SWAR_HIGHS;
+   int n = term ? __builtin_ctzll(term) / 8 : ((unsigned char) y <= ' ' ? 8 : -1);
+   if (n <= 0) { return 0; }
+   uint64_t run = (n == 8) ? ~0ULL : ((1ULL << (8 * n)) - 1);
+
+   // Every byte of the run must be 0-9, a-f or A-F
+   uint64_t lower = x | (SWAR_ONES * 0x20);
+   uint64_t valid = (swar_in_range(x, '0', '9') | swar_in_range(lower, 'a', 'f')) & ~(x & SWAR_HIGHS);
+   if ((valid & run) != (SWAR_HIGHS & run)) { return 0; }
+
+   // ASCII to nibble: '0'-'9' -> 0-9, letters have bit 6 set -> low nibble + 9
+   uint64_t nib = (x & (SWAR_ONES * 0x0F)) + 9 * ((x >> 6) & SWAR_ONES);
+
+   // Right-align the run with the last digit in byte 0, then pack nibbles together
+   nib = __builtin_bswap64(nib << (8 * (8 - n)));
+   nib = (nib | (nib >> 4))  & 0x00FF00FF00FF00FFULL;
+   nib = (nib | (nib >> 8))  & 0x0000FFFF0000FFFFULL;
+   nib = (nib | (nib >> 16)) & 0x00000000FFFFFFFFULL;
+   value = (uint32_t) nib;
+   return n;
+#else
+   (void) p;
+   (void) value;
+   return 0;
+#endif
+}
+
+static inline int hex_digit(char c){
+   if (c >= '0' && c <= '9') { return c - '0'; }
+   if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+   if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+   return -1;
+}
+
+trace_status_t text_trace_reader::next(uint32_t& addr, char& rw){
+   this->skip_space();
+   if (this->pos >= this->end) {
+      if (this->read_failed) {
+         snprintf(this->error, sizeof(this->error), "Unable to read or decompress trace.");
+         return TRACE_ERROR;
+      }
+      return TRACE_EOF;
+   }
+   if (!this->eof && this->end - this->pos < TRACE_TEXT_WINDOW) {
+      this->refill();
+   }
+
+   // Request type
+   const char *p = this->buf + this->pos;
+   rw = *p++;
+   if (rw != 'r' && rw != 'w') {
+      snprintf(this->error, sizeof(this->error), "Unknown request type %c.", rw);
+      this->pos = p - this->buf;
+      return TRACE_ERROR;
+   }
+   while (*p == ' ' || *p == '\t') { p++; }
+
+   // Address: fast path for the usual 1-8 plain hex digits
+   int n = swar_parse_hex(p, addr);
+   if (n > 0) {
+      p += n;
+   } else {
+      // Scalar path: optional 0x prefix, any number of digits
+      if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hex_digit(p[2]) >= 0) { p += 2; }
+      const char *digits = p;
+      uint32_t value = 0;
+      int d;
+      while ((d = hex_digit(*p)) >= 0) {
+         value = (value << 4) | (uint32_t) d;
+         p++;
+      }
+      if (p == digits || (unsigned char) *p > ' ') {
+         snprintf(this->error, sizeof(this->error), "Malformed address.");
+         this->pos = p - this->buf;
+         return TRACE_ERROR;
+      }
+      addr = value;
+   }
+
+   // Optional decimal timestamp column ("r 1fa0 1234"), used to interleave multi-core traces
+   this->timestamp = 0;
+   if (*p == ' ' || *p == '\t') {
+      while (*p == ' ' || *p == '\t') { p++; }
+      while (*p >= '0' && *p <= '9') { this->timestamp = this->timestamp * 10 + (uint64_t)(*p++ - '0'); }
+      while (*p == ' ' || *p == '\t' || *p == '\r') { p++; }
+      if ((size_t)(p - this->buf) < this->end && *p != '\n') {
+         snprintf(this->error, sizeof(this->error), "Malformed timestamp.");
+         this->pos = p - this->buf;
+         return TRACE_ERROR;
+      }
+   }
+
+   this->pos = p - this->buf;
+   return TRACE_OK;
+}
+
+// ------------ Pipelined text traces ------------ //
+pipelined_trace_reader::pipelined_trace_reader() : ring(TRACE_RING_SLOTS) {
+   this->status = TRACE_EOF;
+   this->line = 0;
+   this->error[0] = '\0';
+   this->head = 0;
+   this->tail = 0;
+   this->filled = 0;
+   this->done = true;      // Nothing to consume until open() starts the decode thread
+   this->stop = false;
+}
+
+pipelined_trace_reader::~pipelined_trace_reader(){
+   if (this->decoder.joinable()) {
+      {
+         std::lock_guard<std::mutex> guard(this->lock);
+         this->stop = true;
+      }
+      this->not_full.notify_one();
+      this->decoder.join();
+   }
+}
+
+bool pipelined_trace_reader::open(const char *trace_file){
+   if (!this->reader.open(trace_file)) {
+      return false;
+   }
+   this->done = false;
+   this->decoder = std::thread(&pipelined_trace_reader::decode, this);
+   return true;
+}
+
+// Decode thread: parse into the slot at tail, then hand it to the consumer
+void pipelined_trace_reader::decode(){
+   trace_status_t result = TRACE_OK;
+   while (result == TRACE_OK) {
+      {
+         std::unique_lock<std::mutex> guard(this->lock);
+         this->not_full.wait(guard, [this]{ return this->filled < this->ring.size() || this->stop; });
+         if (this->stop) { return; }
+      }
+
+      // The slot at tail belongs to this thread until it is published
+      trace_batch_t& batch = this->ring[this->tail];
+      batch.count = 0;
+      while (batch.count < TRACE_BATCH_SIZE) {
+         trace_request_t& req = batch.requests[batch.count];
+         result = this->reader.next(req.addr, req.rw);
+         if (result != TRACE_OK) { break; }
+         batch.count++;
+      }
+
+      {
+         std::lock_guard<std::mutex> guard(this->lock);
+         if (batch.count > 0) {
+            this->tail = (this->tail + 1) % this->ring.size();
+            this->filled++;
+         }
+         if (result != TRACE_OK) {
+            this->status = result;
+            this->line = this->reader.line;
+            memcpy(this->error, this->reader.error, sizeof(this->error));
+            this->done = true;
+         }
+      }
+      this->not_empty.notify_one();
+   }
+}
+
+const trace_batch_t* pipelined_trace_reader::next_batch(){
+   std::unique_lock<std::mutex> guard(this->lock);
+   this->not_empty.wait(guard, [this]{ return this->filled > 0 || this->done; });
+   if (this->filled == 0) {
+      return NULL;
+   }
+   return &this->ring[this->head];
+}
+
+void pipelined_trace_reader::release_batch(){
+   {
+      std::lock_guard<std::mutex> guard(this->lock);
+      this->head = (this->head + 1) % this->ring.size();
+      this->filled--;
+   }
+   this->not_full.notify_one();
+}
+
+// ------------ Binary traces ------------ //
+bool is_binary_trace(const char *trace_file){
+   FILE *fp = fopen(trace_file, "rb");
+   if (fp == (FILE *) NULL) {
+      return false;
+   }
+   uint32_t magic = 0;
+   bool binary = fread(&magic, sizeof(magic), 1, fp) == 1 && magic == TRACE_BIN_MAGIC;
+   fclose(fp);
+   return binary;
+}
+
+bool mapped_trace::open(const char *trace_file){
+   this->error = "cannot open the file";
+   int fd = ::open(trace_file, O_RDONLY);
+   if (fd < 0) {
+      return false;
+   }
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(trace_bin_header_t)) {
+      ::close(fd);
+      this->error = "file is shorter than its header";
+      return false;
+   }
+
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);     // The mapping keeps the file alive
+   if (map == MAP_FAILED) {
+      this->error = "cannot map the file";
+      return false;
+   }
+
+   // Requests the file has room for; no rounding, so a corrupt count cannot wrap past the check
+   const trace_bin_header_t *header = (const trace_bin_header_t *) map;
+   uint64_t capacity = (st.st_size - sizeof(trace_bin_header_t)) / sizeof(trace_bin_block_t) * TRACE_BIN_BLOCK;
+   if (header->magic != TRACE_BIN_MAGIC || header->version != TRACE_BIN_VERSION) {
+      munmap(map, st.st_size);
+      this->error = "unsupported format version";
+      return false;
+   }
+   if (header->count > capacity) {
+      munmap(map, st.st_size);
+      this->error = "header counts more requests than the file holds";
+      return false;
+   }
+
+   // The trace is read front to back exactly once
+   madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+   this->base = map;
+   this->length = st.st_size;
+   this->count = header->count;
+   this->blocks = (const trace_bin_block_t *) (header + 1);
+   return true;
+}
+
+void mapped_trace::close(){
+   if (this->base != nullptr) {
+      munmap(this->base, this->length);
+   }
+   this->base = nullptr;
+   this->length = 0;
+   this->blocks = nullptr;
+   this->count = 0;
+}
+
+bool convert_trace(const char *text_file, const char *bin_file){
+   text_trace_reader in;
+   if (!in.open(text_file)) {
+      printf("Error: Unable to open file %s\n", text_file);
+      return false;
+   }
+   FILE *out = fopen(bin_file, "wb");
+   if (out == (FILE *) NULL) {
+      printf("Error: Unable to open file %s\n", bin_file);
+      return false;
+   }
+
+   // Header count is patched once the whole trace has been read
+   trace_bin_header_t header;
+   header.magic = TRACE_BIN_MAGIC;
+   header.version = TRACE_BIN_VERSION;
+   header.count = 0;
+   fwrite(&header, sizeof(header), 1, out);
+
+   trace_bin_block_t block;
+   memset(&block, 0, sizeof(block));
+   char rw;
+   uint32_t addr;
+   trace_status_t status;
+   while ((status = in.next(addr, rw)) == TRACE_OK) {
+      uint32_t slot = header.count % TRACE_BIN_BLOCK;
+      block.addr[slot] = addr;
+      if (rw == 'w') { block.rw_bits |= (uint64_t) 1 << slot; }
+      header.count++;
+
+      if (slot == TRACE_BIN_BLOCK - 1) {
+         fwrite(&block, sizeof(block), 1, out);
+         memset(&block, 0, sizeof(block));
+      }
+   }
+   if (header.count % TRACE_BIN_BLOCK != 0) {
+      fwrite(&block, sizeof(block), 1, out);
+   }
+
+   if (status == TRACE_ERROR) {
+      printf("Error: %s:%" PRIu64 ": %s\n", text_file, in.line, in.error);
+      fclose(out);
+      return false;
+   }
+
+   fseek(out, 0, SEEK_SET);
+   fwrite(&header, sizeof(header), 1, out);
+   bool ok = ferror(out) == 0;
+   fclose(out);
+   if (!ok) {
+      printf("Error: Failed writing %s\n", bin_file);
+   }
+   return ok;
+}
+
+int run_convert(int argc, char *argv[]){
+   if (argc != 4) {
+      printf("Usage: %s --convert <text_trace> <binary_trace>\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+   if (!convert_trace(argv[2], argv[3])) {
+      exit(EXIT_FAILURE);
+   }
+   return(0);
+}
@@ -0,0 +1,110 @@
+// Micro-benchmark: text trace parsing throughput, fscanf loop vs text_trace_reader
+//
+//    ./trace_bench [trace_file ...]     (default: ../test/traces/*.txt)
+//
+// Each file is parsed several times with both readers from the page cache.
+// Both must produce the same requests; the run fails otherwise.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include "Trace.h"
+
+#define BENCH_REPS 20
+
+typedef
+struct {
+   uint64_t count;
+   uint64_t checksum;
+} parse_result_t;
+
+static void mix(parse_result_t& r, uint32_t addr, char rw){
+   r.count++;
+   r.checksum = (r.checksum * 1099511628211ULL) ^ ((uint64_t) addr << 1 | (rw == 'w'));
+}
+
+// The loop main() used before text_trace_reader
+static parse_result_t parse_fscanf(const char *trace_file){
+   parse_result_t r = {0, 0};
+   FILE *fp = fopen(trace_file, "r");
+   if (fp == (FILE *) NULL) { return r; }
+   char rw;
+   uint32_t addr;
+   while (fscanf(fp, "%c %x\n", &rw, &addr) == 2) {
+      mix(r, addr, rw);
+   }
+   fclose(fp);
+   return r;
+}
+
+static parse_result_t parse_reader(const char *trace_file){
+   parse_result_t r = {0, 0};
+   text_trace_reader reader;
+   if (!reader.open(trace_file)) { return r; }
+   char rw;
+   uint32_t addr;
+   while (reader.next(addr, rw) == TRACE_OK) {
+      mix(r, addr, rw);
+   }
+   return r;
+}
+
+// Best-of-N seconds for one parse of the file
+static double time_parser(parse_result_t (*parse)(const char *), const char *trace_file, parse_result_t& result){
+   double best = 1e30;
+   for (int rep = 0; rep < BENCH_REPS; rep++) {
+      auto start = std::chrono::steady_clock::now();
+      result = parse(trace_file);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed.count() < best) { best = elapsed.count(); }
+   }
+   return best;
+}
+
+int main(int argc, char *argv[]){
+   std::vector<std::string> files;
+   for (int i = 1; i < argc; i++) {
+      files.push_back(argv[i]);
+   }
+   if (files.empty()) {
+      glob_t g;
+      if (glob("../test/traces/*.txt", 0, NULL, &g) == 0) {
+         for (size_t i = 0; i < g.gl_pathc; i++) {
+            files.push_back(g.gl_pathv[i]);
+         }
+      }
+      globfree(&g);
+   }
+
+   int failures = 0;
+   printf("trace,bytes,requests,fscanf_MBps,reader_MBps,speedup\n");
+   for (size_t i = 0; i < files.size(); i++) {
+      const char *trace_file = files[i].c_str();
+      struct stat st;
+      if (stat(trace_file, &st) != 0) {
+         printf("Error: Unable to open file %s\n", trace_file);
+         failures++;
+         continue;
+      }
+
+      parse_result_t slow, fast;
+      double slow_s = time_parser(parse_fscanf, trace_file, slow);
+      double fast_s = time_parser(parse_reader, trace_file, fast);
+      if (slow.count != fast.count || slow.checksum != fast.checksum) {
+         printf("Error: %s: readers disagree (%" PRIu64 " vs %" PRIu64 " requests)\n", trace_file, slow.count, fast.count);
+         failures++;
+         continue;
+      }
+
+      double mb = st.st_size / 1e6;
+      printf("%s,%lld,%" PRIu64 ",%.1f,%.1f,%.2f\n", trace_file, (long long) st.st_size, fast.count,
+             mb / slow_s, mb / fast_s, slow_s / fast_s);
+   }
+   return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+// Way-match kernels for cache::lookup, selected at runtime
+
+#include <inttypes.h>
+
+#include "WayMatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WAY_MATCH_X86
+#endif
+
+// Mask with the low num_ways bits set
+static inline uint64_t ways_mask(uint32_t num_ways){
+   return num_ways >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << num_ways) - 1);
+}
+
+way_masks_t way_match_scalar(const uint32_t *tags, uint64_t valid, uint32_t num_ways, uint32_t tag){
+   uint64_t tag_eq = 0;
+   for (uint32_t i = 0; i < num_ways; i++) {
+      tag_eq |= (uint64_t)(tags[i] == tag) << i;
+   }
+   way_masks_t masks;
+   masks.hit = tag_eq & valid;
+   masks.invalid = ~valid & ways_mask(num_ways);
+   return masks;
+}
+
+#ifdef WAY_MATCH_X86
+__attribute__((target("sse2")))
+static way_masks_t way_match_sse2(const uint32_t *tags, uint64_t valid, uint32_t num_ways, uint32_t tag){
+   const __m128i tag4 = _mm_set1_epi32((int)tag);
+   uint64_t tag_eq = 0;
+   uint32_t i = 0;
+   for (; i + 4 <= num_ways; i += 4) {
+      __m128i t = _mm_loadu_si128((const __m128i *)(tags + i));
+      tag_eq |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(t, tag4))) << i;
+   }
+   for (; i < num_ways; i++) {
+      tag_eq |= (uint64_t)(tags[i] == tag) << i;
+   }
+   way_masks_t masks;
+   masks.hit = tag_eq & valid;
+   masks.invalid = ~valid & ways_mask(num_ways);
+   return masks;
+}
+
+__attribute__((target("avx2")))
+static way_masks_t way_match_avx2(const uint32_t *tags, uint64_t valid, uint32_t num_ways, uint32_t tag){
+   const __m256i tag8 = _mm256_set1_epi32((int)tag);
+   uint64_t tag_eq = 0;
+   uint32_t i = 0;
+   for (; i + 8 <= num_ways; i += 8) {
+      __m256i t = _mm256_loadu_si256((const __m256i *)(tags + i));
+      tag_eq |= (uint64_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(t, tag8))) << i;
+   }
+   for (; i < num_ways; i++) {
+      tag_eq |= (uint64_t)(tags[i] == tag) << i;
+   }
+   way_masks_t masks;
+   masks.hit = tag_eq & valid;
+   masks.invalid = ~valid & ways_mask(num_ways);
+   return masks;
+}
+#endif
+
+way_match_fn select_way_match(){
+#ifdef WAY_MATCH_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) { return way_match_avx2; }
+   if (__builtin_cpu_supports("sse2")) { return way_match_sse2; }
+#endif
+   return way_match_scalar;
+}
+
+const char* way_match_name(way_match_fn fn){
+#ifdef WAY_MATCH_X86
+   if (fn == way_match_avx2) { return "avx2"; }
+   if (fn == way_match_sse2) { return "sse2"; }
+#endif
+   (void) fn;
+   return "scalar";
+}